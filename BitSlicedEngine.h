@@ -0,0 +1,178 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "LifeKernel.h"
+
+// Many small universes advanced together. Every cell of the grid is stored as Words machine
+// words and bit i of those words belongs to universe ("lane") i, so 64 * Words independent
+// universes share one grid and one pass of the adder network advances all of them. Unlike
+// the dense engine no bits are shifted between neighbours: the eight neighbour words of a
+// cell are simply the words of the eight neighbouring cells.
+//
+// Words = 1, 4 and 8 give 64, 256 and 512 lanes. The per-word loop has a fixed trip count,
+// so the compiler can map 4 and 8 words onto 256- and 512-bit vector registers.
+namespace BitSlicedEngine {
+
+    template <int Words>
+    class Batch {
+    public:
+        static constexpr int lanes = 64 * Words;
+
+        // One bit per lane.
+        using Mask = std::array<uint64_t, Words>;
+
+        // Grid of width x height cells per lane, surrounded by permanently dead cells.
+        Batch(int width, int height, const LifeKernel::Rule& rule = LifeKernel::Rule::conway())
+            : width(width), height(height), rule(rule) {
+            if (width <= 0 || height <= 0) {
+                throw std::invalid_argument("BitSlicedEngine::Batch needs a positive size");
+            }
+            if (rule.birth & 1) {
+                throw std::invalid_argument("B0 rules would fill the dead border of every lane");
+            }
+            rowStride = size_t(width + 2) * Words;
+            current.assign(rowStride * size_t(height + 2), 0);
+            next = current;
+        }
+
+        int getWidth() const {
+            return width;
+        }
+
+        int getHeight() const {
+            return height;
+        }
+
+        const LifeKernel::Rule& getRule() const {
+            return rule;
+        }
+
+        bool get(int lane, int x, int y) const {
+            return (current[index(x, y) + size_t(lane / 64)] >> (lane % 64)) & 1;
+        }
+
+        void set(int lane, int x, int y, bool alive) {
+            uint64_t& word = current[index(x, y) + size_t(lane / 64)];
+            const uint64_t bit = uint64_t(1) << (lane % 64);
+            word = alive ? (word | bit) : (word & ~bit);
+        }
+
+        // Kills every cell of one lane so it can be refilled without touching the others.
+        void clearLane(int lane) {
+            const uint64_t keep = ~(uint64_t(1) << (lane % 64));
+            for (size_t i = size_t(lane / 64); i < current.size(); i += Words) {
+                current[i] &= keep;
+            }
+        }
+
+        // Advances every lane by one generation.
+        void step() {
+            for (int y = 1; y <= height; ++y) {
+                const uint64_t* above = &current[size_t(y - 1) * rowStride];
+                const uint64_t* row = &current[size_t(y) * rowStride];
+                const uint64_t* below = &current[size_t(y + 1) * rowStride];
+                uint64_t* out = &next[size_t(y) * rowStride];
+                for (int x = 1; x <= width; ++x) {
+                    const size_t w = size_t(x - 1) * Words, c = size_t(x) * Words, e = size_t(x + 1) * Words;
+                    for (int i = 0; i < Words; ++i) {
+                        out[c + i] = LifeKernel::nextWord(above[w + i], above[c + i], above[e + i],
+                                                          row[w + i], row[c + i], row[e + i],
+                                                          below[w + i], below[c + i], below[e + i], rule);
+                    }
+                }
+            }
+            current.swap(next);
+        }
+
+        // Population of every lane. The live cells are summed with a vertical bit-sliced
+        // counter (bit plane p of lane i counts 2^p), so each cell costs a few word operations
+        // for all lanes together instead of one popcount per lane.
+        std::array<uint32_t, lanes> populations() const {
+            int planeCount = 1;
+            while ((size_t(1) << planeCount) <= size_t(width) * size_t(height)) {
+                ++planeCount;
+            }
+            std::vector<uint64_t> planes(size_t(planeCount) * Words, 0);
+            for (int y = 1; y <= height; ++y) {
+                const uint64_t* row = &current[size_t(y) * rowStride];
+                for (size_t c = Words; c <= size_t(width) * Words; c += Words) {
+                    for (int i = 0; i < Words; ++i) {
+                        uint64_t carry = row[c + i];
+                        for (int p = 0; carry; ++p) {
+                            uint64_t& plane = planes[size_t(p) * Words + size_t(i)];
+                            const uint64_t overflow = plane & carry;
+                            plane ^= carry;
+                            carry = overflow;
+                        }
+                    }
+                }
+            }
+
+            std::array<uint32_t, lanes> counts{};
+            for (int lane = 0; lane < lanes; ++lane) {
+                uint32_t count = 0;
+                for (int p = 0; p < planeCount; ++p) {
+                    count |= uint32_t((planes[size_t(p) * Words + size_t(lane / 64)] >> (lane % 64)) & 1) << p;
+                }
+                counts[size_t(lane)] = count;
+            }
+            return counts;
+        }
+
+        // Lanes with a live cell on the outermost ring of the grid. Their next generation
+        // could need cells beyond the grid, so they have to leave the batch before it steps
+        // again; every other lane evolves exactly as it would on an unbounded plane.
+        Mask edgeLanes() const {
+            Mask mask{};
+            auto include = [&](int x, int y) {
+                const size_t base = index(x, y);
+                for (int i = 0; i < Words; ++i) {
+                    mask[size_t(i)] |= current[base + size_t(i)];
+                }
+            };
+            for (int x = 0; x < width; ++x) {
+                include(x, 0);
+                include(x, height - 1);
+            }
+            for (int y = 1; y < height - 1; ++y) {
+                include(0, y);
+                include(width - 1, y);
+            }
+            return mask;
+        }
+
+        static bool contains(const Mask& mask, int lane) {
+            return (mask[size_t(lane / 64)] >> (lane % 64)) & 1;
+        }
+
+        // Calls fn(x, y) for every live cell of one lane.
+        template <typename Fn>
+        void forEachAlive(int lane, Fn&& fn) const {
+            const size_t word = size_t(lane / 64);
+            const int bit = lane % 64;
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    if ((current[index(x, y) + word] >> bit) & 1) {
+                        fn(x, y);
+                    }
+                }
+            }
+        }
+
+    private:
+        size_t index(int x, int y) const {
+            return size_t(y + 1) * rowStride + size_t(x + 1) * Words;
+        }
+
+        int width;
+        int height;
+        LifeKernel::Rule rule;
+        size_t rowStride = 0;
+        std::vector<uint64_t> current;
+        std::vector<uint64_t> next;
+    };
+
+} // namespace BitSlicedEngine
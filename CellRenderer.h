@@ -0,0 +1,176 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "History.h"
+#include "TiledEngine.h"
+
+// Live cells kept in a vertex buffer on the GPU and patched from generation to generation.
+//
+// Every live cell owns a slot of four vertices. A birth takes a free slot, or a new one at the
+// end, and a death collapses its quad and gives the slot back, so only the slots that changed
+// are uploaded, in runs of neighbouring slots. The changes come from the engine when the
+// universe was stepped once since the last update, and otherwise from a History diff against
+// the last state drawn, which only reads the tiles the two do not share. A mostly stable
+// universe therefore uploads a few vertices per frame instead of all of them.
+//
+// Universes with more than maxCells live cells are left to the caller, as are platforms
+// without vertex buffers.
+class CellRenderer {
+public:
+    static constexpr size_t maxCells = size_t(1) << 20;
+
+    explicit CellRenderer(float gridSpacing, sf::Color color = sf::Color(118, 171, 174, 255))
+        : spacing(gridSpacing), cellColor(color), buffer(sf::Quads, sf::VertexBuffer::Stream) {
+    }
+
+    // Brings the buffer up to `universe`. Returns false when this renderer cannot draw it.
+    bool update(const TiledEngine::Universe& universe) {
+        if (!sf::VertexBuffer::isAvailable()) {
+            return false;
+        }
+        if (universe.sharesTilesWith(shown) && universe.getGeneration() == shown.getGeneration() && valid) {
+            return true;
+        }
+        if (!valid) {
+            const size_t population = universe.isTracking() ? universe.getState().population : universe.population();
+            if (population > maxCells) {
+                return false;
+            }
+            reset();
+        }
+
+        if (const TiledEngine::Changes* changes = universe.changesSince(shown)) {
+            for (const TiledEngine::Cell& cell : changes->deaths) {
+                kill(cell.x, cell.y);
+            }
+            for (const TiledEngine::Cell& cell : changes->births) {
+                spawn(cell.x, cell.y);
+            }
+        }
+        else {
+            const History::Delta delta = History::diff(shown, universe);
+            for (const History::TileDelta& change : delta.tiles) {
+                const TiledEngine::Tile* now = universe.findTile(change.key);
+                uint32_t word = change.first;
+                for (uint64_t rows = change.rowMask; rows; rows &= rows - 1) {
+                    const int r = LifeKernel::countTrailingZeros(rows);
+                    const uint64_t alive = now ? now->rows[r] : 0;
+                    for (uint64_t bits = delta.words[word++]; bits; bits &= bits - 1) {
+                        const int column = LifeKernel::countTrailingZeros(bits);
+                        const int x = change.key.x * TiledEngine::tileSize + column;
+                        const int y = change.key.y * TiledEngine::tileSize + r;
+                        (alive >> column) & 1 ? spawn(x, y) : kill(x, y);
+                    }
+                }
+            }
+        }
+
+        if (slots.size() > maxCells) {
+            valid = false;
+            return false;
+        }
+        upload();
+        shown = universe.fork();
+        return true;
+    }
+
+    void draw(sf::RenderTarget& target) const {
+        target.draw(buffer, 0, slotCount * 4);
+    }
+
+    // Vertices uploaded by the last update, for measuring.
+    size_t lastUploadCount() const {
+        return uploaded;
+    }
+
+private:
+    static uint64_t cellKey(int x, int y) {
+        return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+    }
+
+    void reset() {
+        slots.clear();
+        freeSlots.clear();
+        dirty.clear();
+        vertices.clear();
+        slotCount = 0;
+        shown = TiledEngine::Universe();
+        buffer.create(0);
+        valid = true;
+    }
+
+    void spawn(int x, int y) {
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else {
+            slot = uint32_t(slotCount++);
+            vertices.resize(slotCount * 4);
+        }
+        slots[cellKey(x, y)] = slot;
+        const float left = x * spacing, top = y * spacing;
+        sf::Vertex* quad = &vertices[size_t(slot) * 4];
+        quad[0] = sf::Vertex(sf::Vector2f(left, top), cellColor);
+        quad[1] = sf::Vertex(sf::Vector2f(left + spacing, top), cellColor);
+        quad[2] = sf::Vertex(sf::Vector2f(left + spacing, top + spacing), cellColor);
+        quad[3] = sf::Vertex(sf::Vector2f(left, top + spacing), cellColor);
+        dirty.push_back(slot);
+    }
+
+    void kill(int x, int y) {
+        const auto it = slots.find(cellKey(x, y));
+        if (it == slots.end()) {
+            return;
+        }
+        const uint32_t slot = it->second;
+        slots.erase(it);
+        sf::Vertex* quad = &vertices[size_t(slot) * 4];
+        quad[1].position = quad[2].position = quad[3].position = quad[0].position;
+        freeSlots.push_back(slot);
+        dirty.push_back(slot);
+    }
+
+    // Uploads the changed slots, merged into runs; a buffer that has to grow is recreated
+    // with room to spare and filled in one go.
+    void upload() {
+        uploaded = 0;
+        if (vertices.size() > buffer.getVertexCount()) {
+            buffer.create(std::max(vertices.size() * 2, size_t(4096)));
+            buffer.update(vertices.data(), vertices.size(), 0);
+            uploaded = vertices.size();
+            dirty.clear();
+            return;
+        }
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+        for (size_t i = 0; i < dirty.size();) {
+            size_t j = i + 1;
+            while (j < dirty.size() && dirty[j] == dirty[j - 1] + 1) {
+                ++j;
+            }
+            const size_t first = size_t(dirty[i]) * 4, count = (j - i) * 4;
+            buffer.update(vertices.data() + first, count, unsigned(first));
+            uploaded += count;
+            i = j;
+        }
+        dirty.clear();
+    }
+
+    float spacing;
+    sf::Color cellColor;
+    sf::VertexBuffer buffer;
+    std::vector<sf::Vertex> vertices;
+    size_t slotCount = 0;
+    std::unordered_map<uint64_t, uint32_t> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint32_t> dirty;
+    size_t uploaded = 0;
+    TiledEngine::Universe shown;
+    bool valid = false;
+};
@@ -0,0 +1,314 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "TiledEngine.h"
+#include "UniverseHash.h"
+
+// Separation of settled "ash" into objects, classification of every object as a still
+// life, oscillator or spaceship with a canonical code, and the census tables that count
+// them. The codes follow the apgsearch convention: a prefix "xs<population>" for still
+// lifes, "xp<period>" for oscillators and "xq<period>" for spaceships, followed by the
+// pattern in extended Wechsler format, minimised over orientations and phases.
+namespace Census {
+
+    using Rule = LifeKernel::Rule;
+
+    struct Cell {
+        int x, y;
+
+        bool operator<(const Cell& other) const {
+            return y < other.y || (y == other.y && x < other.x);
+        }
+
+        bool operator==(const Cell& other) const {
+            return x == other.x && y == other.y;
+        }
+    };
+
+    using Cells = std::vector<Cell>;
+
+    inline uint64_t packCell(int x, int y) {
+        return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+    }
+
+    inline Cells cellsOf(const TiledEngine::Universe& universe) {
+        Cells cells;
+        universe.forEachAlive([&](int x, int y) { cells.push_back({ x, y }); });
+        return cells;
+    }
+
+    // Object counts of one or more searches. Each worker fills its own table and the
+    // tables are merged once at the end, so counting never needs a lock.
+    struct Table {
+        std::unordered_map<std::string, uint64_t> counts;
+        uint64_t soups = 0;
+        uint64_t unstabilized = 0;
+
+        void add(const std::string& code, uint64_t count = 1) {
+            counts[code] += count;
+        }
+
+        void merge(const Table& other) {
+            for (const auto& entry : other.counts) {
+                counts[entry.first] += entry.second;
+            }
+            soups += other.soups;
+            unstabilized += other.unstabilized;
+        }
+
+        // Entries ordered by decreasing count, then by code.
+        std::vector<std::pair<std::string, uint64_t>> sorted() const {
+            std::vector<std::pair<std::string, uint64_t>> entries(counts.begin(), counts.end());
+            std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+                return a.second != b.second ? a.second > b.second : a.first < b.first;
+            });
+            return entries;
+        }
+    };
+
+    // Moves cells so that their bounding box starts at (0, 0) and sorts them.
+    inline Cells normalize(Cells cells) {
+        if (cells.empty()) {
+            return cells;
+        }
+        int minX = cells[0].x, minY = cells[0].y;
+        for (const Cell& c : cells) {
+            minX = std::min(minX, c.x);
+            minY = std::min(minY, c.y);
+        }
+        for (Cell& c : cells) {
+            c.x -= minX;
+            c.y -= minY;
+        }
+        std::sort(cells.begin(), cells.end());
+        return cells;
+    }
+
+    // Encodes a normalised pattern in extended Wechsler format: the pattern is cut into
+    // strips of five rows, each column of a strip becomes one base-32 digit, runs of empty
+    // columns are shortened to w (2), x (3) or y<n> (4 + n), trailing empty columns are
+    // dropped and strips are separated by z.
+    inline std::string wechsler(const Cells& normalized) {
+        static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+        int width = 0, height = 0;
+        for (const Cell& c : normalized) {
+            width = std::max(width, c.x + 1);
+            height = std::max(height, c.y + 1);
+        }
+        const int strips = (height + 4) / 5;
+        std::vector<int> columns(size_t(width) * size_t(strips), 0);
+        for (const Cell& c : normalized) {
+            columns[size_t(c.y / 5) * size_t(width) + size_t(c.x)] |= 1 << (c.y % 5);
+        }
+
+        std::string code;
+        for (int strip = 0; strip < strips; ++strip) {
+            if (strip > 0) {
+                code += 'z';
+            }
+            int zeros = 0;
+            for (int x = 0; x < width; ++x) {
+                const int value = columns[size_t(strip) * size_t(width) + size_t(x)];
+                if (value == 0) {
+                    ++zeros;
+                    continue;
+                }
+                while (zeros >= 4) {
+                    const int run = std::min(zeros, 39);
+                    code += 'y';
+                    code += digits[run - 4];
+                    zeros -= run;
+                }
+                if (zeros == 3) code += 'x';
+                if (zeros == 2) code += 'w';
+                if (zeros == 1) code += '0';
+                zeros = 0;
+                code += digits[value];
+            }
+        }
+        return code;
+    }
+
+    // The Wechsler code of the best of the eight rotations and reflections of `cells`:
+    // shortest first, then alphabetically smallest.
+    inline std::string canonicalWechsler(const Cells& cells) {
+        std::string best;
+        for (int transform = 0; transform < 8; ++transform) {
+            Cells moved;
+            moved.reserve(cells.size());
+            for (const Cell& c : cells) {
+                int x = (transform & 1) ? -c.x : c.x;
+                int y = (transform & 2) ? -c.y : c.y;
+                if (transform & 4) std::swap(x, y);
+                moved.push_back({ x, y });
+            }
+            const std::string code = wechsler(normalize(moved));
+            if (best.empty() || code.size() < best.size() || (code.size() == best.size() && code < best)) {
+                best = code;
+            }
+        }
+        return best;
+    }
+
+    // Classifies one isolated object by running it on its own until its hash repeats.
+    // Every phase of the cycle is encoded and the best code over all phases is used,
+    // so the result does not depend on the phase the object happened to be found in.
+    // Returns an empty code for fragments that die out once separated from their neighbours.
+    // Objects are small and classified from search workers, so the run steps serially.
+    inline std::string classify(const Cells& object, const Rule& rule = Rule::conway(), int maxPeriod = 64) {
+        TiledEngine::Universe universe(rule);
+        universe.setSerial(true);
+        for (const Cell& c : object) {
+            universe.set(c.x, c.y, true);
+        }
+        universe.setTracking(true);
+        UniverseHash::Detector detector(size_t(maxPeriod) * 2 + 8);
+        detector.record(universe.getState());
+        for (int generation = 0; generation < maxPeriod * 2 + 8 && !detector.result().stable; ++generation) {
+            universe.step();
+            detector.record(universe.getState());
+        }
+        const UniverseHash::Stabilization& verdict = detector.result();
+        if (!verdict.stable) {
+            return "zz_UNSTABLE";
+        }
+        if (universe.population() == 0) {
+            return "";
+        }
+
+        std::string best;
+        for (int phase = 0; phase < verdict.period; ++phase) {
+            const std::string code = canonicalWechsler(cellsOf(universe));
+            if (best.empty() || code.size() < best.size() || (code.size() == best.size() && code < best)) {
+                best = code;
+            }
+            universe.step();
+        }
+        if (verdict.isSpaceship()) {
+            return "xq" + std::to_string(verdict.period) + "_" + best;
+        }
+        if (verdict.period > 1) {
+            return "xp" + std::to_string(verdict.period) + "_" + best;
+        }
+        return "xs" + std::to_string(universe.population()) + "_" + best;
+    }
+
+    // Splits settled ash, whose population repeats every `period` generations, into objects.
+    // The universe is run for one more period and the union of all phases is split into
+    // 8-connected components, so oscillators whose phases are disconnected on their own
+    // (such as the pulsar) stay in one piece. Returns the cells of each object as they are
+    // once the universe has been advanced by that period.
+    inline std::vector<Cells> separate(TiledEngine::Universe& universe, int period) {
+        // The final phase is included as well: a population period says nothing about
+        // spaceships, which have moved on by then.
+        std::unordered_set<uint64_t> envelope;
+        for (int generation = 0; generation <= std::max(period, 1); ++generation) {
+            if (generation > 0) {
+                universe.step();
+            }
+            universe.forEachAlive([&](int x, int y) { envelope.insert(packCell(x, y)); });
+        }
+
+        std::unordered_map<uint64_t, size_t> component;
+        std::vector<Cells> objects;
+        std::vector<uint64_t> stack;
+        for (uint64_t seed : envelope) {
+            if (component.count(seed)) {
+                continue;
+            }
+            const size_t id = objects.size();
+            objects.emplace_back();
+            component[seed] = id;
+            stack.push_back(seed);
+            while (!stack.empty()) {
+                const uint64_t packed = stack.back();
+                stack.pop_back();
+                const int x = int(uint32_t(packed >> 32));
+                const int y = int(uint32_t(packed));
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        const uint64_t neighbor = packCell(x + dx, y + dy);
+                        if (envelope.count(neighbor) && !component.count(neighbor)) {
+                            component[neighbor] = id;
+                            stack.push_back(neighbor);
+                        }
+                    }
+                }
+            }
+        }
+
+        universe.forEachAlive([&](int x, int y) {
+            objects[component.at(packCell(x, y))].push_back({ x, y });
+        });
+        objects.erase(std::remove_if(objects.begin(), objects.end(), [](const Cells& cells) { return cells.empty(); }), objects.end());
+        return objects;
+    }
+
+    // Population of a run at every generation so far, with the test apgsearch uses to decide
+    // that ash has settled: the population has repeated with some period up to maxPeriod for
+    // long enough to trust it. Populations are used rather than whole universes because
+    // escaping gliders keep the universe itself from ever repeating.
+    struct PopulationHistory {
+        std::vector<size_t> populations;
+        int maxPeriod = 30;
+
+        explicit PopulationHistory(int maxPeriod = 30) : maxPeriod(maxPeriod) {}
+
+        // Generation of the last recorded population, -1 before the first one.
+        int generation() const {
+            return int(populations.size()) - 1;
+        }
+
+        // Records the population of the next generation. Every 16 generations the history is
+        // tested and the period returned if it has settled; otherwise returns 0.
+        int record(size_t population) {
+            populations.push_back(population);
+            const int latest = generation();
+            if (latest == 0 || latest % 16 != 0) {
+                return 0;
+            }
+            for (int period = 1; period <= maxPeriod; ++period) {
+                const int window = 6 * period + 30;
+                if (window + period > latest) {
+                    break;
+                }
+                bool repeats = true;
+                for (int i = 0; i < window && repeats; ++i) {
+                    repeats = populations[size_t(latest - i)] == populations[size_t(latest - i - period)];
+                }
+                if (repeats) {
+                    return period;
+                }
+            }
+            return 0;
+        }
+    };
+
+    // Carries on a run whose history so far is `history` until it settles or reaches
+    // maxGenerations. Returns the period, or 0 if the universe had not settled by then.
+    inline int stabilize(TiledEngine::Universe& universe, PopulationHistory& history, int maxGenerations) {
+        if (history.generation() < 0) {
+            history.record(universe.population());
+        }
+        while (history.generation() < maxGenerations) {
+            universe.step();
+            if (const int period = history.record(universe.population())) {
+                return period;
+            }
+        }
+        return 0;
+    }
+
+    // Runs a universe from generation 0 until it settles; see PopulationHistory.
+    inline int stabilize(TiledEngine::Universe& universe, int maxGenerations, int maxPeriod = 30) {
+        PopulationHistory history(maxPeriod);
+        return stabilize(universe, history, maxGenerations);
+    }
+
+} // namespace Census
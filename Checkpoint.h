@@ -0,0 +1,220 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Lz.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "PatternExport.h"
+#include "TiledEngine.h"
+
+// Binary snapshots of a tiled universe for restarting long runs.
+//
+// Layout (little-endian): a 64-byte Header, then tileCount IndexEntry records sorted by tile
+// key, then the tile data. A raw tile is its 64 row words exactly as TiledEngine stores them,
+// at an offset aligned to 64 bytes. A compressed tile is the Lz form of those 512 bytes and
+// is only used when it saves at least a quarter of the space.
+//
+// Loading maps the file with private writes and hands raw tiles to the universe as shared
+// references into the mapping, so nothing is read or copied up front. The engine copies a
+// tile before changing it whenever the mapping or another universe still refers to it, and
+// the first step replaces every tile anyway, so pages are only read as they are stepped.
+namespace Checkpoint {
+
+    using TiledEngine::Tile;
+    using TiledEngine::TileKey;
+    using TiledEngine::TileRef;
+
+    constexpr char magic[8] = { 'G', 'O', 'L', 'T', 'I', 'L', 'E', 'S' };
+    constexpr uint32_t version = 1;
+    constexpr uint32_t byteOrderMark = 0x01020304;
+    constexpr uint64_t tileBytes = sizeof(Tile);
+
+    enum Encoding : uint32_t {
+        Raw = 0,
+        Compressed = 1
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint16_t birth;
+        uint16_t survive;
+        uint8_t bounded;
+        uint8_t topology;
+        uint8_t reserved0[2];
+        int32_t boundsWide;
+        int32_t boundsHigh;
+        uint64_t generation;
+        uint64_t tileCount;
+        uint64_t indexOffset;
+        uint8_t reserved1[8];
+    };
+
+    struct IndexEntry {
+        int32_t x;
+        int32_t y;
+        uint64_t offset;
+        uint32_t size;
+        uint32_t encoding;
+    };
+
+    static_assert(sizeof(Header) == 64, "Checkpoint header must be 64 bytes");
+    static_assert(sizeof(IndexEntry) == 24, "Checkpoint index entries must be 24 bytes");
+    static_assert(sizeof(Tile) == 512, "Tiles must be stored as 64 bare row words");
+
+    inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Writes `universe` to `path`. Tiles are compressed in parallel when `compress` is set;
+    // leaving it off makes every tile loadable in place.
+    inline void save(const std::string& path, const TiledEngine::Universe& universe, bool compress = true) {
+        std::vector<TileKey> keys;
+        keys.reserve(universe.getTiles().size());
+        for (const auto& entry : universe.getTiles()) {
+            keys.push_back(entry.first);
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<std::vector<uint8_t>> packed(compress ? keys.size() : 0);
+        Parallel::forRange(0, packed.size(), [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                const Tile& tile = *universe.findTile(keys[i]);
+                Lz::compress(reinterpret_cast<const uint8_t*>(tile.rows.data()), tileBytes, packed[i]);
+                if (packed[i].size() > tileBytes * 3 / 4) {
+                    packed[i].clear();
+                    packed[i].shrink_to_fit();
+                }
+            }
+        }, 64);
+
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.byteOrder = byteOrderMark;
+        header.birth = universe.getRule().birth;
+        header.survive = universe.getRule().survive;
+        header.bounded = universe.isBounded();
+        header.topology = uint8_t(universe.getTopology());
+        header.boundsWide = universe.getBoundsWide();
+        header.boundsHigh = universe.getBoundsHigh();
+        header.generation = universe.getGeneration();
+        header.tileCount = keys.size();
+        header.indexOffset = sizeof(Header);
+
+        std::vector<IndexEntry> index(keys.size());
+        uint64_t offset = alignUp(sizeof(Header) + sizeof(IndexEntry) * keys.size(), 64);
+        for (size_t i = 0; i < keys.size(); ++i) {
+            const bool packedTile = compress && !packed[i].empty();
+            if (!packedTile) {
+                offset = alignUp(offset, 64);
+            }
+            index[i] = { keys[i].x, keys[i].y, offset, uint32_t(packedTile ? packed[i].size() : tileBytes),
+                         packedTile ? Compressed : Raw };
+            offset += index[i].size;
+        }
+
+        PatternExport::BufferedWriter out(path);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(index.data()), sizeof(IndexEntry) * index.size());
+        uint64_t written = sizeof(Header) + sizeof(IndexEntry) * index.size();
+        for (size_t i = 0; i < keys.size(); ++i) {
+            for (; written < index[i].offset; ++written) {
+                out.put('\0');
+            }
+            if (index[i].encoding == Compressed) {
+                out.write(reinterpret_cast<const char*>(packed[i].data()), packed[i].size());
+            }
+            else {
+                out.write(reinterpret_cast<const char*>(universe.findTile(keys[i])->rows.data()), tileBytes);
+            }
+            written += index[i].size;
+        }
+        out.close();
+    }
+
+    // Replaces the contents of `universe` with the checkpoint at `path`. Raw tiles stay in
+    // the file mapping, which lives as long as any tile refers to it; compressed tiles are
+    // decoded in parallel. Throws std::runtime_error for files that are not valid checkpoints
+    // of this version and byte order.
+    inline void load(const std::string& path, TiledEngine::Universe& universe) {
+        auto file = std::make_shared<MappedFile>(path, true);
+        if (file->size() < sizeof(Header)) {
+            throw std::runtime_error(path + " is not a checkpoint");
+        }
+        Header header;
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error(path + " is not a checkpoint");
+        }
+        if (header.version != version || header.byteOrder != byteOrderMark) {
+            throw std::runtime_error(path + " was written by an incompatible version or platform");
+        }
+        if (header.indexOffset > file->size() || header.tileCount > (file->size() - header.indexOffset) / sizeof(IndexEntry)) {
+            throw std::runtime_error(path + " is truncated");
+        }
+        std::vector<IndexEntry> index(size_t(header.tileCount));
+        std::memcpy(index.data(), file->data() + header.indexOffset, sizeof(IndexEntry) * index.size());
+        for (const IndexEntry& entry : index) {
+            const bool badRaw = entry.encoding == Raw && (entry.size != tileBytes || entry.offset % alignof(Tile) != 0);
+            if (entry.offset > file->size() || entry.size > file->size() - entry.offset || badRaw || entry.encoding > Compressed) {
+                throw std::runtime_error(path + " has a corrupt tile index");
+            }
+        }
+        // Checked here so that a bad header leaves the universe as it was.
+        const bool badBounds = header.bounded && (header.boundsWide <= 0 || header.boundsHigh <= 0 || header.topology > uint8_t(TiledEngine::Topology::Wall));
+        if (badBounds || (!header.bounded && (header.birth & 1))) {
+            throw std::runtime_error(path + " has a corrupt header");
+        }
+
+        universe.clear();
+        if (header.bounded) {
+            universe.setBounds(header.boundsWide, header.boundsHigh, TiledEngine::Topology(header.topology));
+        }
+        universe.setRule({ header.birth, header.survive });
+        if (!header.bounded) {
+            universe.clearBounds();
+        }
+        universe.setGeneration(header.generation);
+
+        std::vector<TileRef> decoded(index.size());
+        Parallel::forRange(0, index.size(), [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                if (index[i].encoding != Compressed) {
+                    continue;
+                }
+                decoded[i] = std::make_shared<Tile>();
+                const uint8_t* source = reinterpret_cast<const uint8_t*>(file->data() + index[i].offset);
+                if (!Lz::decompress(source, index[i].size, reinterpret_cast<uint8_t*>(decoded[i]->rows.data()), tileBytes)) {
+                    decoded[i].reset();
+                }
+            }
+        }, 64);
+
+        for (size_t i = 0; i < index.size(); ++i) {
+            const TileKey key{ index[i].x, index[i].y };
+            if (index[i].encoding == Raw) {
+                // Shares ownership of the mapping, so it stays open while this tile is in use.
+                universe.adoptTile(key, TileRef(file, reinterpret_cast<Tile*>(file->privateData() + index[i].offset)));
+            }
+            else if (decoded[i]) {
+                universe.adoptTile(key, decoded[i]);
+            }
+            else {
+                universe.clear();
+                throw std::runtime_error(path + " has a corrupt tile");
+            }
+        }
+        if (universe.isTracking()) {
+            universe.recomputeState();
+        }
+    }
+
+} // namespace Checkpoint
@@ -0,0 +1,343 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "LifeKernel.h"
+#include "Parallel.h"
+
+namespace DenseEngine {
+
+    using LifeKernel::Rule;
+    using LifeKernel::Topology;
+
+    // A bounded width x height board stored as one bit per cell.
+    // Each row is padded with a ghost column on both sides (bit 0 and bit width + 1 of the
+    // padded row) and the board with a ghost row above and below. Before every step the
+    // ghosts are filled from the opposite edges according to the topology, so the sweep over
+    // the interior never wraps coordinates or tests for edges. Every row additionally has an
+    // all-zero sentinel word at each end, which lets the sweep read its left and right
+    // neighbour words without special-casing the first and last word of the row.
+    class Board {
+    public:
+        Board(int width, int height, Topology topology = Topology::Torus, Rule rule = Rule::conway())
+            : width(width), height(height), topology(topology), rule(rule) {
+            if (width <= 0 || height <= 0) {
+                throw std::invalid_argument("DenseEngine::Board needs a positive size");
+            }
+            words = (width + 2 + 63) / 64;
+            stride = words + 2;
+            cells.assign(size_t(stride) * size_t(height + 2), 0);
+            next = cells;
+
+            interiorMask.assign(stride, 0);
+            for (int p = 1; p <= width; ++p) {
+                interiorMask[1 + p / 64] |= uint64_t(1) << (p % 64);
+            }
+        }
+
+        int getWidth() const {
+            return width;
+        }
+
+        int getHeight() const {
+            return height;
+        }
+
+        Topology getTopology() const {
+            return topology;
+        }
+
+        void setTopology(Topology newTopology) {
+            topology = newTopology;
+        }
+
+        const Rule& getRule() const {
+            return rule;
+        }
+
+        void setRule(const Rule& newRule) {
+            rule = newRule;
+        }
+
+        bool contains(int x, int y) const {
+            return x >= 0 && y >= 0 && x < width && y < height;
+        }
+
+        bool get(int x, int y) const {
+            return contains(x, y) && getPadded(x + 1, y + 1);
+        }
+
+        void set(int x, int y, bool alive) {
+            if (contains(x, y)) {
+                setPadded(x + 1, y + 1, alive);
+            }
+        }
+
+        void clear() {
+            std::fill(cells.begin(), cells.end(), 0);
+        }
+
+        size_t population() const {
+            size_t count = 0;
+            for (int y = 1; y <= height; ++y) {
+                const uint64_t* row = paddedRow(y);
+                for (int k = 1; k <= words; ++k) {
+                    count += LifeKernel::popcount(row[k] & interiorMask[k]);
+                }
+            }
+            return count;
+        }
+
+        // Calls fn(x, y) for every live cell, row by row.
+        template <typename Fn>
+        void forEachAlive(Fn&& fn) const {
+            for (int y = 1; y <= height; ++y) {
+                const uint64_t* row = paddedRow(y);
+                for (int k = 1; k <= words; ++k) {
+                    uint64_t bits = row[k] & interiorMask[k];
+                    while (bits) {
+                        const int bit = LifeKernel::countTrailingZeros(bits);
+                        fn((k - 1) * 64 + bit - 1, y - 1);
+                        bits &= bits - 1;
+                    }
+                }
+            }
+        }
+
+        // Advances the board by one generation.
+        void step() {
+            fillHalo();
+            Parallel::forRange(1, size_t(height) + 1, [&](size_t first, size_t last) {
+                for (size_t y = first; y < last; ++y) {
+                    sweepRow(int(y));
+                }
+            }, 64);
+            cells.swap(next);
+        }
+
+        // Largest number of generations a single temporally blocked pass may advance.
+        static constexpr int maxTemporalDepth = 64;
+
+        // Advances the board by `depth` generations in one pass over memory (temporal blocking).
+        // The board is cut into bands of bandRows rows; each band is copied into a cache-sized
+        // buffer together with a halo of `depth` rows and stepped `depth` times there before its
+        // interior is written back, so the full board is streamed through DRAM once per `depth`
+        // generations instead of once per generation. The cost is 2 * depth / bandRows of
+        // redundant work on the halos. A bandRows of 0 picks a band that keeps both buffers
+        // within about 256 KB. The cross-surface maps rows onto other rows when it wraps
+        // horizontally, so it falls back to `depth` ordinary steps.
+        void stepTemporal(int depth, int bandRows = 0) {
+            if (depth < 1 || depth > maxTemporalDepth) {
+                throw std::invalid_argument("DenseEngine::Board temporal depth out of range");
+            }
+            if (depth == 1 || topology == Topology::CrossSurface) {
+                for (int i = 0; i < depth; ++i) {
+                    step();
+                }
+                return;
+            }
+            if (bandRows <= 0) {
+                const int rowBytes = stride * int(sizeof(uint64_t));
+                bandRows = std::max(4 * depth, (256 * 1024) / (2 * rowBytes) - 2 * depth);
+            }
+            const size_t bands = size_t((height + bandRows - 1) / bandRows);
+            Parallel::forRange(0, bands, [&](size_t firstBand, size_t lastBand) {
+                std::vector<uint64_t> current;
+                std::vector<uint64_t> scratch;
+                for (size_t band = firstBand; band < lastBand; ++band) {
+                    const int first = int(band) * bandRows;
+                    stepBand(first, std::min(height, first + bandRows), depth, current, scratch);
+                }
+            });
+            cells.swap(next);
+        }
+
+        // Advances the board by `generations` generations using temporally blocked passes
+        // of `depth` generations each, finishing with one shorter pass for the remainder.
+        void advance(uint64_t generations, int depth) {
+            for (; generations >= uint64_t(depth); generations -= uint64_t(depth)) {
+                stepTemporal(depth);
+            }
+            if (generations > 0) {
+                stepTemporal(int(generations));
+            }
+        }
+
+        // Raw access to padded rows for engines layered on the board.
+        // Row 0 and row height + 1 are the ghost rows, words 0 and words + 1 the sentinels.
+        const uint64_t* paddedRow(int y) const {
+            return &cells[size_t(y) * size_t(stride)];
+        }
+
+        uint64_t* paddedRow(int y) {
+            return &cells[size_t(y) * size_t(stride)];
+        }
+
+        int getStride() const {
+            return stride;
+        }
+
+        int getWords() const {
+            return words;
+        }
+
+        const std::vector<uint64_t>& getInteriorMask() const {
+            return interiorMask;
+        }
+
+        // Copies the cells just across each edge into the ghost columns and ghost rows.
+        // This is O(width + height) and the only place where the topology is looked at.
+        void fillHalo() {
+            for (int y = 1; y <= height; ++y) {
+                bool westGhost = false;
+                bool eastGhost = false;
+                switch (topology) {
+                case Topology::Torus:
+                case Topology::KleinBottle:
+                    westGhost = getPadded(width, y);
+                    eastGhost = getPadded(1, y);
+                    break;
+                case Topology::CrossSurface:
+                    westGhost = getPadded(width, height + 1 - y);
+                    eastGhost = getPadded(1, height + 1 - y);
+                    break;
+                case Topology::Wall:
+                    break;
+                }
+                setPadded(0, y, westGhost);
+                setPadded(width + 1, y, eastGhost);
+            }
+
+            uint64_t* top = paddedRow(0);
+            uint64_t* bottom = paddedRow(height + 1);
+            switch (topology) {
+            case Topology::Torus:
+                std::copy(paddedRow(height), paddedRow(height) + stride, top);
+                std::copy(paddedRow(1), paddedRow(1) + stride, bottom);
+                break;
+            case Topology::KleinBottle:
+            case Topology::CrossSurface:
+                mirrorRow(paddedRow(height), top);
+                mirrorRow(paddedRow(1), bottom);
+                break;
+            case Topology::Wall:
+                std::fill(top, top + stride, 0);
+                std::fill(bottom, bottom + stride, 0);
+                break;
+            }
+        }
+
+    private:
+        bool getPadded(int px, int py) const {
+            return (paddedRow(py)[1 + px / 64] >> (px % 64)) & 1;
+        }
+
+        void setPadded(int px, int py, bool alive) {
+            uint64_t& word = paddedRow(py)[1 + px / 64];
+            const uint64_t bit = uint64_t(1) << (px % 64);
+            word = alive ? (word | bit) : (word & ~bit);
+        }
+
+        // Writes the padded row `source` into `destination` reversed over columns 0..width+1,
+        // so the ghost columns of the mirrored row also land on the right sides.
+        void mirrorRow(const uint64_t* source, uint64_t* destination) const {
+            std::fill(destination, destination + stride, 0);
+            for (int p = 0; p <= width + 1; ++p) {
+                if ((source[1 + p / 64] >> (p % 64)) & 1) {
+                    const int q = width + 1 - p;
+                    destination[1 + q / 64] |= uint64_t(1) << (q % 64);
+                }
+            }
+        }
+
+        void sweepRow(int y) {
+            sweepWords(paddedRow(y - 1), paddedRow(y), paddedRow(y + 1), &next[size_t(y) * size_t(stride)]);
+        }
+
+        void sweepWords(const uint64_t* above, const uint64_t* row, const uint64_t* below, uint64_t* out) const {
+            for (int k = 1; k <= words; ++k) {
+                out[k] = LifeKernel::nextWord(above + k - 1, row + k - 1, below + k - 1, rule) & interiorMask[k];
+            }
+        }
+
+        static int floorDiv(int value, int divisor) {
+            return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+        }
+
+        // Copies board row y into a band buffer row, resolving rows beyond the top and
+        // bottom edges through the topology. Ghost columns are refreshed separately.
+        void loadBandRow(int y, uint64_t* destination) const {
+            const int wraps = floorDiv(y, height);
+            const uint64_t* source = paddedRow(y - wraps * height + 1);
+            if (topology == Topology::Wall && wraps != 0) {
+                std::fill(destination, destination + stride, 0);
+            }
+            else if (topology == Topology::KleinBottle && (wraps & 1)) {
+                mirrorRow(source, destination);
+            }
+            else {
+                std::copy(source, source + stride, destination);
+            }
+        }
+
+        // Sets the ghost columns of a band row from the row itself. Only topologies that
+        // wrap each row onto itself horizontally can be temporally blocked by row bands.
+        void refreshGhostColumns(uint64_t* row) const {
+            const bool wraps = topology != Topology::Wall;
+            const bool westGhost = wraps && ((row[1 + width / 64] >> (width % 64)) & 1);
+            const bool eastGhost = wraps && ((row[1] >> 1) & 1);
+            row[1] = (row[1] & ~uint64_t(1)) | uint64_t(westGhost);
+            const uint64_t eastBit = uint64_t(1) << ((width + 1) % 64);
+            uint64_t& eastWord = row[1 + (width + 1) / 64];
+            eastWord = eastGhost ? (eastWord | eastBit) : (eastWord & ~eastBit);
+        }
+
+        // Advances rows [first, last) of the board by `depth` generations into `next`.
+        // The band is loaded with `depth` extra rows on each side into two small ping-pong
+        // buffers; every generation the valid region shrinks by one row at each end, so after
+        // `depth` generations exactly the band's own rows are correct and are written back.
+        void stepBand(int first, int last, int depth, std::vector<uint64_t>& current, std::vector<uint64_t>& scratch) {
+            const int rows = last - first + 2 * depth;
+            current.resize(size_t(rows) * size_t(stride));
+            scratch.resize(current.size());
+            for (int i = 0; i < rows; ++i) {
+                loadBandRow(first - depth + i, &current[size_t(i) * size_t(stride)]);
+            }
+
+            for (int generation = 1; generation <= depth; ++generation) {
+                for (int i = generation - 1; i < rows - generation + 1; ++i) {
+                    refreshGhostColumns(&current[size_t(i) * size_t(stride)]);
+                }
+                for (int i = generation; i < rows - generation; ++i) {
+                    uint64_t* out = &scratch[size_t(i) * size_t(stride)];
+                    const int y = first - depth + i;
+                    if (topology == Topology::Wall && (y < 0 || y >= height)) {
+                        std::fill(out, out + stride, 0);
+                        continue;
+                    }
+                    sweepWords(&current[size_t(i - 1) * size_t(stride)], &current[size_t(i) * size_t(stride)],
+                               &current[size_t(i + 1) * size_t(stride)], out);
+                }
+                current.swap(scratch);
+            }
+
+            for (int y = first; y < last; ++y) {
+                const uint64_t* source = &current[size_t(y - first + depth) * size_t(stride)];
+                std::copy(source, source + stride, &next[size_t(y + 1) * size_t(stride)]);
+            }
+        }
+
+        int width;
+        int height;
+        int words;
+        int stride;
+        Topology topology;
+        Rule rule;
+        std::vector<uint64_t> cells;
+        std::vector<uint64_t> next;
+        std::vector<uint64_t> interiorMask;
+    };
+
+} // namespace DenseEngine
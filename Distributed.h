@@ -0,0 +1,475 @@
+#pragma once
+#include <SFML/Network.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Selection.h"
+#include "TiledEngine.h"
+
+// A walled board too large for one process, split into rectangular domains that separate
+// processes step together over TCP.
+//
+// The board is tilesWide x tilesHigh tiles, cut into a grid of columns x rows domains of
+// whole tiles, one per rank. Each process keeps the cells of its own domain in a tiled
+// universe bounded like the whole board. To advance k generations at once it first receives
+// from each of its up to eight neighbours the cells of their domain within k cells of its
+// own, steps k times, and drops everything outside its domain again. A wrong cell at the
+// outer edge of the received halo spreads inwards by one cell per generation, so after k
+// steps the domain itself is still exact. The halo width is the number of generations
+// between exchanges: a wider halo sends more cells but exchanges, and waits, less often.
+//
+// Halos travel in sf::Packet as the rows of the region packed 64 cells to a word. Every
+// process listens on basePort + rank and keeps one connection to each neighbour and to rank
+// 0, which runs a barrier after every exchange and step and collects the results.
+// Communication, compute and barrier time are measured per process.
+namespace Distributed {
+
+    constexpr unsigned short defaultPort = 52000;
+
+    // How the board is cut: domain (c, r) is rank r * columns + c.
+    struct Layout {
+        int tilesWide = 0;
+        int tilesHigh = 0;
+        int columns = 1;
+        int rows = 1;
+
+        int ranks() const {
+            return columns * rows;
+        }
+
+        // The cells of a rank's domain.
+        Selection::Rect domain(int rank) const {
+            const int c = rank % columns, r = rank / columns;
+            const int x0 = c * tilesWide / columns, x1 = (c + 1) * tilesWide / columns;
+            const int y0 = r * tilesHigh / rows, y1 = (r + 1) * tilesHigh / rows;
+            return { x0 * TiledEngine::tileSize, y0 * TiledEngine::tileSize, (x1 - x0) * TiledEngine::tileSize, (y1 - y0) * TiledEngine::tileSize };
+        }
+
+        // Ranks whose domain touches the rank's domain at an edge or a corner.
+        std::vector<int> neighbours(int rank) const {
+            std::vector<int> result;
+            const int c = rank % columns, r = rank / columns;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const int nc = c + dx, nr = r + dy;
+                    if ((dx || dy) && nc >= 0 && nc < columns && nr >= 0 && nr < rows) {
+                        result.push_back(nr * columns + nc);
+                    }
+                }
+            }
+            return result;
+        }
+    };
+
+    // The grid of `ranks` domains with the shortest total cut.
+    inline Layout makeLayout(int tilesWide, int tilesHigh, int ranks) {
+        if (tilesWide <= 0 || tilesHigh <= 0 || ranks <= 0) {
+            throw std::invalid_argument("Distributed layout needs a board and at least one rank");
+        }
+        Layout best;
+        long long bestCut = -1;
+        for (int columns = 1; columns <= ranks; ++columns) {
+            const int rows = ranks / columns;
+            if (columns * rows != ranks || columns > tilesWide || rows > tilesHigh) {
+                continue;
+            }
+            const long long cut = (long long)(columns - 1) * tilesHigh + (long long)(rows - 1) * tilesWide;
+            if (bestCut < 0 || cut < bestCut) {
+                best = { tilesWide, tilesHigh, columns, rows };
+                bestCut = cut;
+            }
+        }
+        if (bestCut < 0) {
+            throw std::invalid_argument("Board is too small for " + std::to_string(ranks) + " domains");
+        }
+        return best;
+    }
+
+    inline Selection::Rect intersection(const Selection::Rect& a, const Selection::Rect& b) {
+        const int x0 = std::max(a.x, b.x), y0 = std::max(a.y, b.y);
+        const int x1 = std::min(a.x + a.width, b.x + b.width), y1 = std::min(a.y + a.height, b.y + b.height);
+        return { x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0) };
+    }
+
+    inline Selection::Rect grown(const Selection::Rect& rect, int by) {
+        return { rect.x - by, rect.y - by, rect.width + 2 * by, rect.height + 2 * by };
+    }
+
+    // Appends the cells of `region`, row by row, 64 to a word.
+    inline void pack(const TiledEngine::Universe& universe, const Selection::Rect& region, sf::Packet& packet) {
+        uint64_t word = 0;
+        int used = 0;
+        auto append = [&](uint64_t bits, int count) {
+            word |= bits << used;
+            if (used + count >= 64) {
+                packet << sf::Uint64(word);
+                word = used ? bits >> (64 - used) : 0;
+                used += count - 64;
+            }
+            else {
+                used += count;
+            }
+        };
+        for (int y = region.y; y < region.y + region.height; ++y) {
+            const int ty = TiledEngine::tileCoord(y), row = TiledEngine::inTile(y);
+            for (int x = region.x; x < region.x + region.width;) {
+                const int tx = TiledEngine::tileCoord(x), shift = TiledEngine::inTile(x);
+                const int count = std::min(TiledEngine::tileSize - shift, region.x + region.width - x);
+                const TiledEngine::Tile* tile = universe.findTile({ tx, ty });
+                const uint64_t mask = count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+                append(tile ? (tile->rows[row] >> shift) & mask : 0, count);
+                x += count;
+            }
+        }
+        if (used) {
+            packet << sf::Uint64(word);
+        }
+    }
+
+    // Reads cells packed by pack() for the same region and ORs them into the universe.
+    inline void unpack(sf::Packet& packet, const Selection::Rect& region, TiledEngine::Universe& universe) {
+        uint64_t word = 0;
+        int left = 0;
+        auto take = [&](int count) {
+            uint64_t bits = word;
+            if (left < count) {
+                sf::Uint64 next = 0;
+                if (!(packet >> next)) {
+                    throw std::runtime_error("Halo packet is too short");
+                }
+                const int consumed = count - left;
+                bits |= uint64_t(next) << left;
+                word = consumed == 64 ? 0 : uint64_t(next) >> consumed;
+                left = 64 - consumed;
+            }
+            else {
+                word = count == 64 ? 0 : word >> count;
+                left -= count;
+            }
+            return count == 64 ? bits : bits & ((uint64_t(1) << count) - 1);
+        };
+        std::unordered_map<TiledEngine::TileKey, TiledEngine::Tile, TiledEngine::TileKeyHash> tiles;
+        for (int y = region.y; y < region.y + region.height; ++y) {
+            const int ty = TiledEngine::tileCoord(y), row = TiledEngine::inTile(y);
+            for (int x = region.x; x < region.x + region.width;) {
+                const int tx = TiledEngine::tileCoord(x), shift = TiledEngine::inTile(x);
+                const int count = std::min(TiledEngine::tileSize - shift, region.x + region.width - x);
+                if (const uint64_t bits = take(count)) {
+                    tiles[{ tx, ty }].rows[row] |= bits << shift;
+                }
+                x += count;
+            }
+        }
+        for (const auto& entry : tiles) {
+            universe.mergeTile(entry.first, entry.second);
+        }
+    }
+
+    // Time per process, summed over the generations advanced so far.
+    struct Times {
+        uint64_t generations = 0;
+        double computeMs = 0;
+        double communicationMs = 0;
+        double barrierMs = 0;
+        uint64_t bytesSent = 0;
+    };
+
+    // What each rank reports to rank 0 at the end.
+    struct Summary {
+        int rank = 0;
+        uint64_t population = 0;
+        uint64_t hash = 0;
+        Times times;
+    };
+
+    class Node {
+    public:
+        // `hosts` holds the address of every rank; empty means all of them run on this machine.
+        Node(const Layout& layout, int rank, int halo, unsigned short basePort = defaultPort, std::vector<sf::IpAddress> hosts = {})
+            : layout(layout), rank(rank), halo(halo), basePort(basePort), hosts(std::move(hosts)), domain(layout.domain(rank)) {
+            if (rank < 0 || rank >= layout.ranks()) {
+                throw std::invalid_argument("Rank " + std::to_string(rank) + " is not part of the layout");
+            }
+            for (int other = 0; other < layout.ranks(); ++other) {
+                const Selection::Rect area = layout.domain(other);
+                if (halo < 1 || halo > area.width || halo > area.height) {
+                    throw std::invalid_argument("Halo width must lie between 1 and the smallest domain side");
+                }
+            }
+            if (!this->hosts.empty() && int(this->hosts.size()) != layout.ranks()) {
+                throw std::invalid_argument("Distributed run needs one host per rank");
+            }
+            universe.setBounds(layout.tilesWide, layout.tilesHigh, TiledEngine::Topology::Wall);
+            universe.setTracking(true);
+            neighbours = layout.neighbours(rank);
+        }
+
+        Node(const Node&) = delete;
+        Node& operator=(const Node&) = delete;
+
+        int getRank() const {
+            return rank;
+        }
+
+        const Selection::Rect& getDomain() const {
+            return domain;
+        }
+
+        // This rank's cells. Fill it before connecting; cells outside the domain are dropped
+        // by the first advance.
+        TiledEngine::Universe& getUniverse() {
+            return universe;
+        }
+
+        const Times& getTimes() const {
+            return times;
+        }
+
+        // Connects to every neighbour and, for all but rank 0, to rank 0. Ranks may start in
+        // any order within `timeout`.
+        void connect(sf::Time timeout = sf::seconds(30)) {
+            std::vector<int> wanted = neighbours;
+            if (rank == 0) {
+                for (int other = 1; other < layout.ranks(); ++other) {
+                    wanted.push_back(other);
+                }
+            }
+            else {
+                wanted.push_back(0);
+            }
+            std::sort(wanted.begin(), wanted.end());
+            wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+            sf::TcpListener listener;
+            if (listener.listen(static_cast<unsigned short>(basePort + rank)) != sf::Socket::Done) {
+                throw std::runtime_error("Cannot listen on port " + std::to_string(basePort + rank));
+            }
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout.asMicroseconds());
+
+            // Lower ranks are dialled, higher ranks dial in and introduce themselves.
+            for (int other : wanted) {
+                if (other > rank) {
+                    continue;
+                }
+                auto socket = std::make_unique<sf::TcpSocket>();
+                while (socket->connect(hostOf(other), static_cast<unsigned short>(basePort + other), sf::seconds(1)) != sf::Socket::Done) {
+                    if (std::chrono::steady_clock::now() > deadline) {
+                        throw std::runtime_error("Rank " + std::to_string(other) + " did not answer");
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                }
+                sf::Packet hello;
+                hello << sf::Uint32(rank);
+                peers[other] = std::move(socket);
+                send(other, hello);
+            }
+            const size_t expected = size_t(std::count_if(wanted.begin(), wanted.end(), [&](int other) { return other > rank; }));
+            for (size_t accepted = 0; accepted < expected; ++accepted) {
+                auto socket = std::make_unique<sf::TcpSocket>();
+                if (!readyBefore(listener, deadline)) {
+                    const auto missing = std::find_if(wanted.begin(), wanted.end(), [&](int other) { return other > rank && !peers.count(other); });
+                    throw std::runtime_error("Rank " + std::to_string(*missing) + " did not answer");
+                }
+                if (listener.accept(*socket) != sf::Socket::Done) {
+                    throw std::runtime_error("Accepting a rank failed");
+                }
+                sf::Packet hello;
+                sf::Uint32 other = 0;
+                if (!readyBefore(*socket, deadline)) {
+                    throw std::runtime_error("A rank connected but did not introduce itself");
+                }
+                if (socket->receive(hello) != sf::Socket::Done || !(hello >> other) || peers.count(int(other))) {
+                    throw std::runtime_error("A rank introduced itself wrongly");
+                }
+                peers[int(other)] = std::move(socket);
+            }
+        }
+
+        // Advances the domain by `generations`, in blocks of up to the halo width.
+        void advance(uint64_t generations) {
+            clip();
+            while (generations > 0) {
+                const int block = int(std::min<uint64_t>(generations, uint64_t(halo)));
+                auto start = std::chrono::steady_clock::now();
+                exchange(block);
+                auto end = std::chrono::steady_clock::now();
+                times.communicationMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+                start = end;
+                for (int g = 0; g < block; ++g) {
+                    universe.step();
+                }
+                clip();
+                end = std::chrono::steady_clock::now();
+                times.computeMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+                start = end;
+                barrier();
+                times.barrierMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                times.generations += uint64_t(block);
+                generations -= uint64_t(block);
+            }
+        }
+
+        // Sends this rank's summary to rank 0. Rank 0 returns every rank's, in rank order;
+        // the others return their own. Populations and hashes of the domains add up to those
+        // of the whole board.
+        std::vector<Summary> gather() {
+            Summary own;
+            own.rank = rank;
+            own.population = universe.getState().population;
+            own.hash = universe.getState().hash;
+            own.times = times;
+            if (rank != 0) {
+                sf::Packet packet;
+                packet << sf::Uint8(summaryTag) << sf::Uint64(own.population) << sf::Uint64(own.hash) << sf::Uint64(own.times.generations)
+                       << own.times.computeMs << own.times.communicationMs << own.times.barrierMs << sf::Uint64(own.times.bytesSent);
+                send(0, packet);
+                return { own };
+            }
+            std::vector<Summary> all(size_t(layout.ranks()));
+            all[0] = own;
+            for (int other = 1; other < layout.ranks(); ++other) {
+                sf::Packet packet = receive(other, summaryTag);
+                Summary& summary = all[size_t(other)];
+                summary.rank = other;
+                sf::Uint64 population, hash, generations, bytes;
+                packet >> population >> hash >> generations >> summary.times.computeMs >> summary.times.communicationMs >> summary.times.barrierMs >> bytes;
+                summary.population = population;
+                summary.hash = hash;
+                summary.times.generations = generations;
+                summary.times.bytesSent = bytes;
+            }
+            return all;
+        }
+
+    private:
+        static constexpr sf::Uint8 haloTag = 1;
+        static constexpr sf::Uint8 barrierTag = 2;
+        static constexpr sf::Uint8 summaryTag = 3;
+
+        // Whether `socket` has a connection or data waiting before `deadline`.
+        static bool readyBefore(sf::Socket& socket, std::chrono::steady_clock::time_point deadline) {
+            const auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+            sf::SocketSelector selector;
+            selector.add(socket);
+            // A zero timeout would wait forever.
+            return selector.wait(sf::microseconds(std::max<long long>(left, 1)));
+        }
+
+        sf::IpAddress hostOf(int other) const {
+            return hosts.empty() ? sf::IpAddress::LocalHost : hosts[size_t(other)];
+        }
+
+        void send(int other, sf::Packet& packet) {
+            if (peers.at(other)->send(packet) != sf::Socket::Done) {
+                throw std::runtime_error("Lost the connection to rank " + std::to_string(other));
+            }
+        }
+
+        // The next packet from `other`, which must start with `tag`.
+        sf::Packet receive(int other, sf::Uint8 tag) {
+            sf::Packet packet;
+            sf::Uint8 got = 0;
+            if (peers.at(other)->receive(packet) != sf::Socket::Done) {
+                throw std::runtime_error("Lost the connection to rank " + std::to_string(other));
+            }
+            if (!(packet >> got) || got != tag) {
+                throw std::runtime_error("Rank " + std::to_string(other) + " is out of step");
+            }
+            return packet;
+        }
+
+        // Sends each neighbour our cells within `width` of its domain and merges theirs. The
+        // sends run on a second thread so that no pair of ranks waits on each other's buffers.
+        void exchange(int width) {
+            std::vector<sf::Packet> outgoing(neighbours.size());
+            for (size_t i = 0; i < neighbours.size(); ++i) {
+                outgoing[i] << haloTag << sf::Uint64(universe.getGeneration());
+                pack(universe, intersection(domain, grown(layout.domain(neighbours[i]), width)), outgoing[i]);
+                times.bytesSent += outgoing[i].getDataSize();
+            }
+            std::string failure;
+            std::thread sender([&]() {
+                for (size_t i = 0; i < neighbours.size(); ++i) {
+                    if (peers.at(neighbours[i])->send(outgoing[i]) != sf::Socket::Done) {
+                        failure = "Lost the connection to rank " + std::to_string(neighbours[i]);
+                        return;
+                    }
+                }
+            });
+            try {
+                for (int other : neighbours) {
+                    sf::Packet packet = receive(other, haloTag);
+                    sf::Uint64 generation = 0;
+                    packet >> generation;
+                    if (generation != universe.getGeneration()) {
+                        throw std::runtime_error("Rank " + std::to_string(other) + " sent a halo of another generation");
+                    }
+                    unpack(packet, intersection(layout.domain(other), grown(domain, width)), universe);
+                }
+            }
+            catch (...) {
+                sender.join();
+                throw;
+            }
+            sender.join();
+            if (!failure.empty()) {
+                throw std::runtime_error(failure);
+            }
+        }
+
+        // Every rank reports to rank 0, which answers once all have.
+        void barrier() {
+            sf::Packet packet;
+            packet << barrierTag;
+            if (rank != 0) {
+                send(0, packet);
+                receive(0, barrierTag);
+                return;
+            }
+            for (int other = 1; other < layout.ranks(); ++other) {
+                receive(other, barrierTag);
+            }
+            for (int other = 1; other < layout.ranks(); ++other) {
+                send(other, packet);
+            }
+        }
+
+        // Drops the tiles outside the domain; domains are whole tiles.
+        void clip() {
+            std::vector<TiledEngine::TileKey> outside;
+            const int x0 = domain.x / TiledEngine::tileSize, y0 = domain.y / TiledEngine::tileSize;
+            const int x1 = x0 + domain.width / TiledEngine::tileSize, y1 = y0 + domain.height / TiledEngine::tileSize;
+            for (const auto& entry : universe.getTiles()) {
+                const TiledEngine::TileKey& key = entry.first;
+                if (key.x < x0 || key.x >= x1 || key.y < y0 || key.y >= y1) {
+                    outside.push_back(key);
+                }
+            }
+            for (const TiledEngine::TileKey& key : outside) {
+                universe.putTile(key, TiledEngine::Tile());
+            }
+        }
+
+        const Layout layout;
+        const int rank;
+        const int halo;
+        const unsigned short basePort;
+        const std::vector<sf::IpAddress> hosts;
+        const Selection::Rect domain;
+        std::vector<int> neighbours;
+        std::map<int, std::unique_ptr<sf::TcpSocket>> peers;
+        TiledEngine::Universe universe;
+        Times times;
+    };
+
+} // namespace Distributed
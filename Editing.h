@@ -0,0 +1,114 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "TiledEngine.h"
+
+// Cell edits collected from the mouse and applied to a tiled universe in one go.
+//
+// Input events only append to a batch, so a fast drag costs nothing until the batch is
+// applied, once per frame. Applying sorts the edits by tile and row, keeps the last edit of
+// each cell, and then reads and writes every touched tile exactly once, however large the
+// universe is.
+namespace Editing {
+
+    struct Edit {
+        int x;
+        int y;
+        bool alive;
+        uint32_t order;
+    };
+
+    // Calls fn(x, y) for every cell of the Bresenham line from (x0, y0) to (x1, y1), both
+    // ends included, so a drag leaves no gaps however far the mouse moved between events.
+    template <typename Fn>
+    void line(int x0, int y0, int x1, int y1, Fn&& fn) {
+        const int dx = std::abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+        const int dy = -std::abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+        int error = dx + dy;
+        while (true) {
+            fn(x0, y0);
+            if (x0 == x1 && y0 == y1) {
+                return;
+            }
+            const int twice = 2 * error;
+            if (twice >= dy) {
+                error += dy;
+                x0 += sx;
+            }
+            if (twice <= dx) {
+                error += dx;
+                y0 += sy;
+            }
+        }
+    }
+
+    class Batch {
+    public:
+        void set(int x, int y, bool alive) {
+            edits.push_back({ x, y, alive, uint32_t(edits.size()) });
+        }
+
+        void setLine(int x0, int y0, int x1, int y1, bool alive) {
+            line(x0, y0, x1, y1, [&](int x, int y) { set(x, y, alive); });
+        }
+
+        bool empty() const {
+            return edits.empty();
+        }
+
+        size_t size() const {
+            return edits.size();
+        }
+
+        void clear() {
+            edits.clear();
+        }
+
+        // Applies and clears the pending edits. Returns how many cells actually changed.
+        size_t apply(TiledEngine::Universe& universe) {
+            using TiledEngine::tileCoord;
+            using TiledEngine::inTile;
+            std::sort(edits.begin(), edits.end(), [](const Edit& a, const Edit& b) {
+                const TiledEngine::TileKey keyA{ tileCoord(a.x), tileCoord(a.y) }, keyB{ tileCoord(b.x), tileCoord(b.y) };
+                if (keyA != keyB) return keyA < keyB;
+                if (a.y != b.y) return a.y < b.y;
+                if (a.x != b.x) return a.x < b.x;
+                return a.order < b.order;
+            });
+
+            size_t changed = 0;
+            size_t i = 0;
+            while (i < edits.size()) {
+                const TiledEngine::TileKey key{ tileCoord(edits[i].x), tileCoord(edits[i].y) };
+                const TiledEngine::Tile* current = universe.findTile(key);
+                TiledEngine::Tile tile = current ? *current : TiledEngine::Tile{};
+                size_t tileChanges = 0;
+                for (; i < edits.size() && key == TiledEngine::TileKey{ tileCoord(edits[i].x), tileCoord(edits[i].y) }; ++i) {
+                    // Only the last edit of a cell counts.
+                    if (i + 1 < edits.size() && edits[i + 1].x == edits[i].x && edits[i + 1].y == edits[i].y) {
+                        continue;
+                    }
+                    uint64_t& row = tile.rows[inTile(edits[i].y)];
+                    const uint64_t bit = uint64_t(1) << inTile(edits[i].x);
+                    if (bool(row & bit) != edits[i].alive) {
+                        row ^= bit;
+                        ++tileChanges;
+                    }
+                }
+                if (tileChanges) {
+                    universe.putTile(key, tile);
+                    changed += tileChanges;
+                }
+            }
+            edits.clear();
+            return changed;
+        }
+
+    private:
+        std::vector<Edit> edits;
+    };
+
+} // namespace Editing
@@ -0,0 +1,144 @@
+#pragma once
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "Parallel.h"
+
+namespace Fft {
+
+    using Complex = std::complex<float>;
+
+    // Returns true when n is a non-zero power of two, the only sizes the
+    // radix-2 transforms below accept.
+    inline bool isPowerOfTwo(size_t n) {
+        return n != 0 && (n & (n - 1)) == 0;
+    }
+
+    // A precomputed one-dimensional radix-2 transform of a fixed length.
+    // The bit-reversal permutation and the twiddle factors are built once so that
+    // repeated transforms of rows and columns only perform the butterflies.
+    class Plan {
+    public:
+        Plan() = default;
+
+        explicit Plan(size_t length) : length(length) {
+            if (!isPowerOfTwo(length)) {
+                throw std::invalid_argument("Fft::Plan length must be a power of two");
+            }
+            size_t bits = 0;
+            while ((size_t(1) << bits) < length) {
+                ++bits;
+            }
+            reversed.resize(length);
+            for (size_t i = 0; i < length; ++i) {
+                size_t r = 0;
+                for (size_t b = 0; b < bits; ++b) {
+                    r |= ((i >> b) & 1) << (bits - 1 - b);
+                }
+                reversed[i] = r;
+            }
+            twiddles.resize(length / 2);
+            const double pi = std::acos(-1.0);
+            for (size_t k = 0; k < length / 2; ++k) {
+                const double angle = -2.0 * pi * double(k) / double(length);
+                twiddles[k] = Complex(float(std::cos(angle)), float(std::sin(angle)));
+            }
+        }
+
+        size_t size() const {
+            return length;
+        }
+
+        // Transforms length samples in place. The inverse transform is left unscaled,
+        // callers fold the 1/N factor into whatever pointwise pass follows it.
+        void transform(Complex* data, bool inverse) const {
+            for (size_t i = 0; i < length; ++i) {
+                if (i < reversed[i]) {
+                    std::swap(data[i], data[reversed[i]]);
+                }
+            }
+            for (size_t half = 1; half < length; half <<= 1) {
+                const size_t stride = length / (half * 2);
+                for (size_t start = 0; start < length; start += half * 2) {
+                    for (size_t k = 0; k < half; ++k) {
+                        const Complex w = inverse ? std::conj(twiddles[k * stride]) : twiddles[k * stride];
+                        const Complex t = w * data[start + k + half];
+                        data[start + k + half] = data[start + k] - t;
+                        data[start + k] += t;
+                    }
+                }
+            }
+        }
+
+    private:
+        size_t length = 0;
+        std::vector<size_t> reversed;
+        std::vector<Complex> twiddles;
+    };
+
+    // Two-dimensional transform of a row-major width x height grid.
+    // Rows are transformed in parallel, the grid is transposed in small square tiles
+    // so both source and destination stay in cache, and the former columns are then
+    // transformed as contiguous rows before being transposed back.
+    class Plan2D {
+    public:
+        static constexpr size_t transposeTile = 32;
+
+        Plan2D() = default;
+
+        Plan2D(size_t width, size_t height)
+            : width(width), height(height), rowPlan(width), columnPlan(height), scratch(width * height) {}
+
+        size_t getWidth() const {
+            return width;
+        }
+
+        size_t getHeight() const {
+            return height;
+        }
+
+        void transform(std::vector<Complex>& grid, bool inverse) {
+            transformRows(grid.data(), width, height, rowPlan, inverse);
+            transpose(grid.data(), scratch.data(), width, height);
+            transformRows(scratch.data(), height, width, columnPlan, inverse);
+            transpose(scratch.data(), grid.data(), height, width);
+        }
+
+    private:
+        static void transformRows(Complex* data, size_t rowLength, size_t rows, const Plan& plan, bool inverse) {
+            Parallel::forRange(0, rows, [&](size_t first, size_t last) {
+                for (size_t row = first; row < last; ++row) {
+                    plan.transform(data + row * rowLength, inverse);
+                }
+            }, 8);
+        }
+
+        // Writes the transpose of the cols x rows source into destination, tile by tile.
+        static void transpose(const Complex* source, Complex* destination, size_t cols, size_t rows) {
+            const size_t tileRows = (rows + transposeTile - 1) / transposeTile;
+            Parallel::forRange(0, tileRows, [&](size_t first, size_t last) {
+                for (size_t tileY = first * transposeTile; tileY < std::min(rows, last * transposeTile); tileY += transposeTile) {
+                    for (size_t tileX = 0; tileX < cols; tileX += transposeTile) {
+                        const size_t endY = std::min(rows, tileY + transposeTile);
+                        const size_t endX = std::min(cols, tileX + transposeTile);
+                        for (size_t y = tileY; y < endY; ++y) {
+                            for (size_t x = tileX; x < endX; ++x) {
+                                destination[x * rows + y] = source[y * cols + x];
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+        size_t width = 0;
+        size_t height = 0;
+        Plan rowPlan;
+        Plan columnPlan;
+        std::vector<Complex> scratch;
+    };
+
+} // namespace Fft
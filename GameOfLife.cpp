@@ -38,23 +38,70 @@ void drawGrid(sf::RenderWindow& window, const sf::View& view, float gridSpacing)
 	}
 }
 
-void addPoint(std::vector<Point>& points, int x, int y, const int gridSpacing, const sf::Color& color, const float size = 50) {
-	points.emplace_back(x, y, color, size);
-}
-
-void removePoint(std::vector<Point>& points, const std::vector<Point>::iterator& it) {
-
-	points.erase(it);
-}
+// Draws the live cells inside the view as a single vertex array. When the view spans fewer
+// tiles than the universe holds, tiles are looked up by position, so a huge universe only
+// costs what is on screen. Once cells shrink below two pixels, every 8x8 block holding a
+// live cell is drawn as one quad instead of up to 64.
+void drawCells(sf::RenderWindow& window, const sf::View& view, const TiledEngine::Universe& universe, const float gridSpacing, sf::VertexArray& vertices) {
+	const sf::Vector2f viewSize = view.getSize();
+	const sf::Vector2f viewCenter = view.getCenter();
+	const int minX = static_cast<int>(std::floor((viewCenter.x - viewSize.x / 2) / gridSpacing));
+	const int maxX = static_cast<int>(std::floor((viewCenter.x + viewSize.x / 2) / gridSpacing));
+	const int minY = static_cast<int>(std::floor((viewCenter.y - viewSize.y / 2) / gridSpacing));
+	const int maxY = static_cast<int>(std::floor((viewCenter.y + viewSize.y / 2) / gridSpacing));
+	const int block = viewSize.x / gridSpacing > window.getSize().x / 2.0f ? 8 : 1;
+	const sf::Color color(118, 171, 174, 255);
+
+	vertices.clear();
+	auto addQuad = [&](int x, int y, int cells) {
+		const float left = x * gridSpacing, top = y * gridSpacing, side = cells * gridSpacing;
+		vertices.append(sf::Vertex(sf::Vector2f(left, top), color));
+		vertices.append(sf::Vertex(sf::Vector2f(left + side, top), color));
+		vertices.append(sf::Vertex(sf::Vector2f(left + side, top + side), color));
+		vertices.append(sf::Vertex(sf::Vector2f(left, top + side), color));
+	};
+	auto drawTile = [&](const TiledEngine::TileKey& key, const TiledEngine::Tile& tile) {
+		const int originX = key.x * TiledEngine::tileSize;
+		const int originY = key.y * TiledEngine::tileSize;
+		for (int r = 0; r < TiledEngine::tileSize; r += block) {
+			uint64_t bits = 0;
+			for (int k = 0; k < block; ++k) {
+				bits |= tile.rows[r + k];
+			}
+			if (originY + r + block <= minY || originY + r > maxY) {
+				continue;
+			}
+			while (bits) {
+				const int column = LifeKernel::countTrailingZeros(bits) / block * block;
+				if (originX + column + block > minX && originX + column <= maxX) {
+					addQuad(originX + column, originY + r, block);
+				}
+				bits &= block > 1 ? ~(uint64_t(0xFF) << column) : bits - 1;
+			}
+		}
+	};
 
-void redrawPoints(sf::RenderWindow& window, const std::vector<Point>& points, const int gridSpacing) {
-	for (const auto& point : points) {
-		sf::RectangleShape square(sf::Vector2f(point.size, point.size));
-		const float offset = (gridSpacing - point.size) / 2.0f;
-		square.setPosition(point.x * gridSpacing + offset, point.y * gridSpacing + offset);
-		square.setFillColor(point.color);
-		window.draw(square);
+	const int firstTileX = TiledEngine::tileCoord(minX), lastTileX = TiledEngine::tileCoord(maxX);
+	const int firstTileY = TiledEngine::tileCoord(minY), lastTileY = TiledEngine::tileCoord(maxY);
+	const long long visibleTiles = (long long)(lastTileX - firstTileX + 1) * (lastTileY - firstTileY + 1);
+	if (visibleTiles < (long long)universe.getTiles().size()) {
+		for (int ty = firstTileY; ty <= lastTileY; ++ty) {
+			for (int tx = firstTileX; tx <= lastTileX; ++tx) {
+				if (const TiledEngine::Tile* tile = universe.findTile({ tx, ty })) {
+					drawTile({ tx, ty }, *tile);
+				}
+			}
+		}
 	}
+	else {
+		for (const auto& entry : universe.getTiles()) {
+			const TiledEngine::TileKey& key = entry.first;
+			if (key.x >= firstTileX && key.x <= lastTileX && key.y >= firstTileY && key.y <= lastTileY) {
+				drawTile(key, *entry.second);
+			}
+		}
+	}
+	window.draw(vertices);
 }
 
 void setupPannel(sf::Text& text, sf::Font font, std::string title, uint16_t size, sf::Color color)
@@ -65,7 +112,12 @@ void setupPannel(sf::Text& text, sf::Font font, std::string title, uint16_t size
 	text.setFillColor(sf::Color::Color(238, 238, 238));
 }
 
-int main() {
+int main(int argc, char** argv) {
+	int exitCode = 0;
+	if (HeadlessRunner::run(argc, argv, exitCode)) {
+		return exitCode;
+	}
+
 	sf::Clock clock;
 	const float updateInterval = 0.05;
 
@@ -81,21 +133,330 @@ int main() {
 
 	UIManager uiManager(font, window);
 
+	// Only the index is opened here; a pattern's file is read the first time it is selected
+	PatternLibrary::Library patternLibrary;
+	try {
+		patternLibrary = PatternLibrary::Library("Patterns");
+	}
+	catch (const std::exception& error) {
+		std::cerr << "Couldn't open pattern library: " << error.what() << "\n";
+	}
+	uiManager.setPatternOptions(patternLibrary.size(), [&](size_t index) { return patternLibrary.name(index); });
+
 	sf::View mainView(window.getView());
 	float zoomFactor = 1.0f;
 
 	const float gridSpacing = 50.0f;
-	std::vector<Point> points;
+
+	// The cells live in the tiled engine, which tracks the universe hash as it steps and
+	// gives O(1) lookups for editing. Mouse edits gather in a batch applied once per frame.
+	TiledEngine::Universe universe;
+	universe.setTracking(true);
+	Editing::Batch edits;
+	sf::VertexArray cellVertices(sf::Quads);
+	// Steps list their births and deaths, so the cell buffer only uploads what changed.
+	// Zoomed out far enough for the block view, cells are drawn from the tiles instead.
+	universe.setRecordingChanges(true);
+	CellRenderer cellRenderer(gridSpacing);
+	bool painting = false;
+	bool paintAlive = true;
+	sf::Vector2i lastPainted;
+
+	// Rectangle selected by dragging with the right button, for the clipboard and transforms
+	bool selecting = false;
+	bool hasSelection = false;
+	sf::Vector2i selectionAnchor;
+	Selection::Rect selection;
+
+	// Continuous (Lenia) mode, toggled with the L key, replaces the discrete cells
+	// with a real-valued field drawn through a texture on the same grid.
+	bool continuousMode = false;
+	LeniaEngine::Field leniaField(256, 256);
+	LeniaEngine::FieldRenderer leniaRenderer;
+	unsigned leniaSeed = 1;
+
+	// Detector that watches the universe hash settle
+	UniverseHash::Detector stabilization;
+	// Every generation and every edit is recorded, so the run can be scrubbed and stepped back.
+	// An edit in the past branches the history there and drops the future it replaced.
+	History::Timeline timeline;
+	timeline.reset(universe);
+	bool scrubbing = false;
+	// Every edit, and whatever the run did between edits, can be undone with Ctrl+Z and
+	// redone with Ctrl+Y. A paint stroke is one edit from press to release.
+	Undo::Stack undo;
+	bool strokeOpen = false;
+
+	auto resetStabilization = [&]() {
+		stabilization.reset();
+		uiManager.setStatus("");
+		timeline.record(universe);
+	};
+
+	// The next generations are computed ahead on a spare core while the game is paused or
+	// waiting for its next tick, so stepping and resuming usually just take a ready one.
+	// Any edit discards them, since the universe then no longer matches what they follow.
+	Lookahead::Speculator lookahead;
+
+	// G starts collecting the spaceships that leave the pattern as it is now, so a gun can run
+	// indefinitely without the universe growing; G again stops it.
+	std::unique_ptr<Sinks::Collector> collector;
+
+	// E switches to light cone evaluation: running then only steps the regions whose cells
+	// can reach the view, and patterns far off stay frozen until the view comes near them.
+	// Anything that needs the whole universe, such as an edit, the history or another key,
+	// first brings every region up to the shown generation and switches back.
+	std::unique_ptr<LightCone::Universe> cone;
+	TiledEngine::Universe coneCells;
+
+	// The cells the main view covers.
+	auto viewBox = [&]() {
+		const sf::Vector2f viewSize = mainView.getSize();
+		const sf::Vector2f viewCenter = mainView.getCenter();
+		UniverseHash::BoundingBox box;
+		box.include(static_cast<int>(std::floor((viewCenter.x - viewSize.x / 2) / gridSpacing)),
+					static_cast<int>(std::floor((viewCenter.y - viewSize.y / 2) / gridSpacing)));
+		box.include(static_cast<int>(std::floor((viewCenter.x + viewSize.x / 2) / gridSpacing)),
+					static_cast<int>(std::floor((viewCenter.y + viewSize.y / 2) / gridSpacing)));
+		return box;
+	};
+
+	auto leaveCone = [&]() {
+		if (!cone) {
+			return;
+		}
+		universe = cone->collect();
+		cone.reset();
+		coneCells.clear();
+		universe.setTracking(true);
+		universe.setRecordingChanges(true);
+		resetStabilization();
+	};
+
+	// Computes the next generation and records it.
+	auto advance = [&]() {
+		if (cone) {
+			cone->advanceTo(cone->getGeneration() + 1, viewBox());
+			return;
+		}
+		lookahead.step(universe);
+		if (collector && collector->collect(universe)) {
+			uiManager.setStatus(collector->describe());
+		}
+		timeline.record(universe);
+		const bool wasStable = stabilization.result().stable;
+		const UniverseHash::Stabilization& verdict = stabilization.record(universe.getState());
+		if (verdict.stable && !wasStable) {
+			uiManager.setStatus(verdict.describe());
+			if (uiManager.isAutoPauseChecked()) {
+				uiManager.setRunning(false);
+			}
+		}
+	};
+
+	// Called after the universe was moved to a recorded generation, which is not recorded again.
+	auto showHistoryFrame = [&]() {
+		stabilization.reset();
+		uiManager.setStatus("");
+	};
+
+	auto scrubTo = [&](uint64_t generation) {
+		uiManager.setRunning(false);
+		if (generation != universe.getGeneration() && !timeline.empty()) {
+			timeline.reconstruct(generation, universe);
+			showHistoryFrame();
+		}
+	};
+
+	// Ends a paint stroke, applying what it left pending, so that it becomes one undo step.
+	auto finishStroke = [&]() {
+		const bool changed = !edits.empty() && edits.apply(universe);
+		if (strokeOpen) {
+			undo.commit(universe);
+			strokeOpen = false;
+			painting = false;
+		}
+		if (changed) {
+			resetStabilization();
+		}
+	};
+
+	// Runs an edit as one undo step.
+	auto applyEdit = [&](auto change) {
+		finishStroke();
+		undo.begin(universe);
+		change();
+		if (undo.commit(universe)) {
+			resetStabilization();
+		}
+	};
+
+	// After an undo or redo, a state from the recorded run is shown as such; an edited state
+	// branches the history like any other edit.
+	auto showUndoneState = [&](uint64_t previousGeneration) {
+		const uint64_t generation = universe.getGeneration();
+		if (generation != previousGeneration && !timeline.empty() &&
+			generation >= timeline.earliest() && generation <= timeline.latest()) {
+			showHistoryFrame();
+		}
+		else {
+			resetStabilization();
+		}
+	};
+
+	auto cellAt = [&](sf::Vector2i mousePos) {
+		const sf::Vector2f worldPos = window.mapPixelToCoords(mousePos, mainView);
+		return sf::Vector2i(static_cast<int>(std::floor(worldPos.x / gridSpacing)), static_cast<int>(std::floor(worldPos.y / gridSpacing)));
+	};
+
+	// Replaces the selected cells by a transformed copy of them anchored at the same corner.
+	auto transformSelection = [&](auto transform) {
+		if (!hasSelection) {
+			return;
+		}
+		applyEdit([&]() {
+			const Selection::Clip clip = transform(Selection::copy(universe, selection));
+			Selection::clear(universe, selection);
+			selection.width = clip.width;
+			selection.height = clip.height;
+			Selection::paste(universe, clip, selection.x, selection.y, Selection::Mode::Or);
+		});
+	};
 
 	bool panning = false;
 	sf::Vector2f panStart;
 
+	// Frames are only drawn while something can change. When the game is stopped and the last
+	// frame is still current, the loop sleeps in waitEvent until the next event instead of
+	// redrawing the same picture 60 times a second. Mouse moves only count when they drag
+	// something, so moving the pointer over an idle window costs nothing either.
+	bool redraw = true;
+
 	while (window.isOpen()) {
 		sf::Event event;
-		while (window.pollEvent(event)) {
+		bool idle = !redraw && !uiManager.isGameRunning() && edits.empty();
+		while (idle ? window.waitEvent(event) : window.pollEvent(event)) {
+			idle = false;
+			if (event.type != sf::Event::MouseMoved || painting || panning || selecting || scrubbing) {
+				redraw = true;
+			}
+
 			if (event.type == sf::Event::Closed)
 				window.close();
 
+			if (cone && event.type == sf::Event::KeyPressed && event.key.code != sf::Keyboard::E) {
+				leaveCone();
+			}
+			if (cone && event.type == sf::Event::MouseButtonPressed && event.mouseButton.button != sf::Mouse::Middle) {
+				const sf::Vector2i mousePos(event.mouseButton.x, event.mouseButton.y);
+				const bool viewOnly = event.mouseButton.button == sf::Mouse::Left &&
+					(uiManager.getStartButton().getGlobalBounds().contains(sf::Vector2f(mousePos)) || uiManager.isCheckboxClicked(mousePos) ||
+					 uiManager.isAutoPauseClicked(mousePos));
+				if (!viewOnly) {
+					leaveCone();
+				}
+			}
+
+			if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::E && !continuousMode) {
+				if (cone) {
+					leaveCone();
+				}
+				else {
+					finishStroke();
+					try {
+						cone = std::make_unique<LightCone::Universe>(universe);
+						uiManager.setStatus("Stepping only what can reach the view");
+					}
+					catch (const std::exception& error) {
+						uiManager.setStatus(error.what());
+					}
+				}
+			}
+
+			if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::L) {
+				continuousMode = !continuousMode;
+				if (continuousMode) {
+					const int center = static_cast<int>(leniaField.getWidth() / 2);
+					leniaField.seedNoise(center, center, leniaField.getParams().radius * 2, leniaSeed++);
+				}
+			}
+
+			// Left steps back through the history, Right steps forward (computing a new
+			// generation once the end of the history is reached)
+			if (event.type == sf::Event::KeyPressed && !continuousMode &&
+				(event.key.code == sf::Keyboard::Left || event.key.code == sf::Keyboard::Right)) {
+				uiManager.setRunning(false);
+				if (event.key.code == sf::Keyboard::Left ? timeline.stepBack(universe) : timeline.stepForward(universe)) {
+					showHistoryFrame();
+				}
+				else if (event.key.code == sf::Keyboard::Right) {
+					advance();
+				}
+			}
+
+			// Ctrl+C, Ctrl+X and Ctrl+V exchange the selection with the clipboard as RLE. A paste
+			// lands at the mouse and ORs onto the cells there, XORs with Shift and ANDs with Alt.
+			// Delete clears the selection, R turns it clockwise (Shift: counterclockwise), F
+			// mirrors it left to right (Shift: top to bottom) and Escape drops it.
+			if (event.type == sf::Event::KeyPressed && !continuousMode) {
+				const sf::Keyboard::Key key = event.key.code;
+				if (event.key.control && (key == sf::Keyboard::Z || key == sf::Keyboard::Y)) {
+					finishStroke();
+					uiManager.setRunning(false);
+					const uint64_t generation = universe.getGeneration();
+					const bool redo = key == sf::Keyboard::Y || event.key.shift;
+					if (redo ? undo.redo(universe) : undo.undo(universe)) {
+						showUndoneState(generation);
+					}
+				}
+				else if (event.key.control && (key == sf::Keyboard::C || key == sf::Keyboard::X) && hasSelection) {
+					finishStroke();
+					sf::Clipboard::setString(Selection::toRle(Selection::copy(universe, selection), universe.getRule().toString()));
+					if (key == sf::Keyboard::X) {
+						applyEdit([&]() { Selection::clear(universe, selection); });
+					}
+				}
+				else if (event.key.control && key == sf::Keyboard::V) {
+					try {
+						const Selection::Clip clip = Selection::fromText(sf::Clipboard::getString().toAnsiString());
+						const sf::Vector2i corner = cellAt(sf::Mouse::getPosition(window));
+						const Selection::Mode mode = event.key.shift ? Selection::Mode::Xor : event.key.alt ? Selection::Mode::And : Selection::Mode::Or;
+						applyEdit([&]() { Selection::paste(universe, clip, corner.x, corner.y, mode); });
+						selection = { corner.x, corner.y, clip.width, clip.height };
+						hasSelection = !selection.empty();
+					}
+					catch (const std::exception& error) {
+						uiManager.setStatus(std::string("Cannot paste: ") + error.what());
+					}
+				}
+				else if (key == sf::Keyboard::Delete && hasSelection) {
+					applyEdit([&]() { Selection::clear(universe, selection); });
+				}
+				else if (key == sf::Keyboard::R) {
+					const bool clockwise = !event.key.shift;
+					transformSelection([clockwise](const Selection::Clip& clip) { return Selection::rotated(clip, clockwise); });
+				}
+				else if (key == sf::Keyboard::F) {
+					const bool horizontal = !event.key.shift;
+					transformSelection([horizontal](const Selection::Clip& clip) { return Selection::mirrored(clip, horizontal); });
+				}
+				else if (key == sf::Keyboard::G) {
+					finishStroke();
+					const UniverseHash::BoundingBox& box = universe.getState().box;
+					if (collector || box.isEmpty()) {
+						collector.reset();
+						uiManager.setStatus("");
+					}
+					else {
+						collector = std::make_unique<Sinks::Collector>(Selection::Rect{ box.minX, box.minY, box.maxX - box.minX + 1, box.maxY - box.minY + 1 });
+						uiManager.setStatus("Collecting escaping ships");
+					}
+				}
+				else if (key == sf::Keyboard::Escape) {
+					hasSelection = false;
+				}
+			}
+
 			if (event.type == sf::Event::Resized) {
 				float aspectRatio = static_cast<float>(event.size.width) / static_cast<float>(event.size.height);
 				sf::View resizedView(sf::FloatRect(0, 0, event.size.width, event.size.height));
@@ -103,10 +464,14 @@ int main() {
 				window.setView(resizedView);
 				mainView.setSize(event.size.width * zoomFactor, event.size.height * zoomFactor);
 				mainView.setCenter(event.size.width / 2, event.size.height / 2);
+				uiManager.invalidate();
 			}
 
 
-			if (event.type == sf::Event::MouseWheelScrolled) {
+			if (event.type == sf::Event::MouseWheelScrolled && uiManager.isDropdownExpanded()) {
+				uiManager.handleEvent(window, event);
+			}
+			else if (event.type == sf::Event::MouseWheelScrolled) {
 				if (event.mouseWheelScroll.delta > 0) {
 					zoomFactor *= 0.9f; // Zoom in
 				}
@@ -131,6 +496,44 @@ int main() {
 				panning = false;
 			}
 
+			if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left) {
+				scrubbing = false;
+				finishStroke();
+			}
+
+			if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Right && !continuousMode &&
+				!uiManager.isRestrainedClick(sf::Vector2i(event.mouseButton.x, event.mouseButton.y))) {
+				selecting = true;
+				hasSelection = true;
+				selectionAnchor = cellAt(sf::Vector2i(event.mouseButton.x, event.mouseButton.y));
+				selection = { selectionAnchor.x, selectionAnchor.y, 1, 1 };
+			}
+
+			if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Right) {
+				selecting = false;
+			}
+
+			if (event.type == sf::Event::MouseMoved && selecting) {
+				const sf::Vector2i cell = cellAt(sf::Vector2i(event.mouseMove.x, event.mouseMove.y));
+				selection.x = std::min(cell.x, selectionAnchor.x);
+				selection.y = std::min(cell.y, selectionAnchor.y);
+				selection.width = std::abs(cell.x - selectionAnchor.x) + 1;
+				selection.height = std::abs(cell.y - selectionAnchor.y) + 1;
+			}
+
+			// Dragging paints the cells between the last and the current mouse position
+			if (event.type == sf::Event::MouseMoved && painting && !uiManager.isRestrainedClick(sf::Vector2i(event.mouseMove.x, event.mouseMove.y))) {
+				const sf::Vector2i cell = cellAt(sf::Vector2i(event.mouseMove.x, event.mouseMove.y));
+				if (cell != lastPainted) {
+					edits.setLine(lastPainted.x, lastPainted.y, cell.x, cell.y, paintAlive);
+					lastPainted = cell;
+				}
+			}
+
+			if (event.type == sf::Event::MouseMoved && scrubbing) {
+				scrubTo(uiManager.timelineGenerationAt(sf::Mouse::getPosition(window).x));
+			}
+
 			if (event.type == sf::Event::MouseMoved && panning) {
 				const sf::Vector2f panEnd = window.mapPixelToCoords(sf::Mouse::getPosition(window));
 				const sf::Vector2f panDelta = panStart - panEnd;
@@ -142,7 +545,15 @@ int main() {
 				sf::Vector2i mousePos = sf::Mouse::getPosition(window);
 
 				if (uiManager.isClearButtonClicked(mousePos)) {
-					points.clear();
+					edits.clear();
+					applyEdit([&]() { universe.clear(); });
+					hasSelection = false;
+					leniaField.clear();
+				}
+
+				if (uiManager.isAutoPauseClicked(mousePos)) {
+					uiManager.toggleAutoPause();
+					break;
 				}
 
 				// Toggle grid display if the checkbox is clicked
@@ -156,30 +567,40 @@ int main() {
 					break;
 				}
 
+				if (uiManager.isTimelineClicked(mousePos) && !continuousMode) {
+					scrubbing = true;
+					scrubTo(uiManager.timelineGenerationAt(mousePos.x));
+					break;
+				}
+
 				if (uiManager.isRestrainedClick(mousePos)) {
 					uiManager.handleEvent(window, event);
 					break;
 				}
 
-				sf::Vector2f worldPos = window.mapPixelToCoords(sf::Mouse::getPosition(window), mainView);
-				const int gridX = std::floor(worldPos.x / gridSpacing);
-				const int gridY = std::floor(worldPos.y / gridSpacing);
+				const sf::Vector2i cell = cellAt(mousePos);
 
-				auto it = std::find_if(points.begin(), points.end(), [gridX, gridY](const Point& point) {
-					return point.x == gridX && point.y == gridY;
-				});
-
-				if (it != points.end())
-				{
-					removePoint(points, it);
-				}
-				else
-				{
-					addPoint(points, gridX, gridY, gridSpacing, sf::Color::Color(118, 171, 174, 255));
+				if (continuousMode) {
+					leniaField.seedNoise(cell.x, cell.y, leniaField.getParams().radius, leniaSeed++);
+					break;
 				}
+
+				// The first cell toggles, and the rest of the drag paints the same state
+				finishStroke();
+				undo.begin(universe);
+				strokeOpen = true;
+				painting = true;
+				paintAlive = !universe.get(cell.x, cell.y);
+				lastPainted = cell;
+				edits.set(cell.x, cell.y, paintAlive);
 			}
 		}
 
+		if (!redraw && !uiManager.isGameRunning()) {
+			continue;
+		}
+		redraw = false;
+
 		window.clear(sf::Color::Color(34, 40, 49));
 		window.setView(mainView);
 
@@ -189,25 +610,79 @@ int main() {
 			drawGrid(window, mainView, gridSpacing);
 		}
 
-		// Points
-		if (uiManager.isGameRunning()) {
-			if (clock.getElapsedTime().asSeconds() >= updateInterval) {
-				points = GolEngine::nextGeneration(points);
-				clock.restart(); // Reset the clock after updating
-			}
+		if (!edits.empty() && edits.apply(universe)) {
+			resetStabilization();
 		}
 
-		redrawPoints(window, points, gridSpacing);
-
+		// Placed before the cells are drawn, so that the pattern shows in this frame
 		std::string selectedPattern = uiManager.getSelectedPattern();
 		if (!selectedPattern.empty()) {
 			const int startX = 0;
 			const int startY = 0;
-			GolEngine::placePattern(selectedPattern, startX, startY, points);
+			try {
+				const size_t index = patternLibrary.find(selectedPattern);
+				if (index < patternLibrary.size()) {
+					// Placed through the selection path, which ORs whole tiles and so never duplicates a cell
+					int originX = 0, originY = 0;
+					const Selection::Clip clip = Selection::crop(*patternLibrary.get(index), originX, originY);
+					applyEdit([&]() { Selection::paste(universe, clip, startX + originX, startY + originY, Selection::Mode::Or); });
+				}
+			}
+			catch (const std::exception& error) {
+				std::cerr << "Couldn't load " << selectedPattern << ": " << error.what() << "\n";
+			}
 			uiManager.clearSelectedPattern();
 		}
 
+		// Cells
+		if (uiManager.isGameRunning()) {
+			if (clock.getElapsedTime().asSeconds() >= updateInterval) {
+				if (continuousMode) {
+					leniaField.step();
+				}
+				else {
+					advance();
+				}
+				clock.restart(); // Reset the clock after updating
+			}
+		}
+
+		if (continuousMode) {
+			leniaRenderer.update(leniaField);
+			leniaRenderer.draw(window, gridSpacing);
+		}
+		else {
+			const bool cellsVisible = mainView.getSize().x / gridSpacing <= window.getSize().x / 2.0f;
+			if (cone) {
+				// Catches up the regions a moved view has just come to see
+				const UniverseHash::BoundingBox view = viewBox();
+				cone->advanceTo(cone->getGeneration(), view);
+				coneCells.clear();
+				cone->forEachAliveIn(view, [&](int x, int y) { coneCells.set(x, y, true); });
+				drawCells(window, mainView, coneCells, gridSpacing, cellVertices);
+			}
+			else if (cellsVisible && cellRenderer.update(universe)) {
+				cellRenderer.draw(window);
+			}
+			else {
+				drawCells(window, mainView, universe, gridSpacing, cellVertices);
+			}
+			if (hasSelection) {
+				sf::RectangleShape outline(sf::Vector2f(selection.width * gridSpacing, selection.height * gridSpacing));
+				outline.setPosition(selection.x * gridSpacing, selection.y * gridSpacing);
+				outline.setFillColor(sf::Color(238, 238, 238, 30));
+				outline.setOutlineColor(sf::Color(238, 238, 238, 200));
+				outline.setOutlineThickness(2.0f * zoomFactor);
+				window.draw(outline);
+			}
+		}
+
+		if (!continuousMode && !cone) {
+			lookahead.follow(universe);
+		}
+
 		// Draw UI
+		uiManager.setTimeline(timeline.earliest(), timeline.latest(), cone ? cone->getGeneration() : universe.getGeneration());
 		window.setView(window.getDefaultView());
 		uiManager.draw(window);
 
@@ -3,5 +3,15 @@
 #include <iostream> // cerr
 #include <cmath>
 
-#include "GolEngine.h"
-#include "UiManager.h"
\ No newline at end of file
+#include "CellRenderer.h"
+#include "Editing.h"
+#include "HeadlessRunner.h"
+#include "History.h"
+#include "LeniaEngine.h"
+#include "LightCone.h"
+#include "Lookahead.h"
+#include "PatternLibrary.h"
+#include "Selection.h"
+#include "Sinks.h"
+#include "UiManager.h"
+#include "Undo.h"
\ No newline at end of file
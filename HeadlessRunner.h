@@ -0,0 +1,643 @@
+#pragma once
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "Checkpoint.h"
+#include "DenseEngine.h"
+#include "Distributed.h"
+#include "HybridEngine.h"
+#include "LightCone.h"
+#include "Lookahead.h"
+#include "PatternExport.h"
+#include "PatternImport.h"
+#include "PatternLibrary.h"
+#include "Sinks.h"
+#include "SoupSearch.h"
+
+// Command line modes that run without opening a window, for benchmarks and batch jobs.
+// Every mode is selected by a leading "--" argument; without one the viewer starts as usual.
+namespace HeadlessRunner {
+
+    // Reads the positional argument at `index` as an integer, or returns `fallback` if absent.
+    inline long long argumentOr(const std::vector<std::string>& args, size_t index, long long fallback) {
+        return index < args.size() ? std::atoll(args[index].c_str()) : fallback;
+    }
+
+    // Sets the cells of a reproducible random soup of the given density in the width x height
+    // rectangle at (originX, originY) of any universe with set(x, y, alive), leaving the
+    // cells that come out dead as they are.
+    template <typename Universe>
+    void fillRandom(Universe& universe, int originX, int originY, int width, int height, double density, unsigned seed) {
+        std::mt19937 generator(seed);
+        std::bernoulli_distribution alive(density);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                if (alive(generator)) {
+                    universe.set(originX + x, originY + y, true);
+                }
+            }
+        }
+    }
+
+    // Fills a board with a reproducible random soup of the given density.
+    inline void fillRandom(DenseEngine::Board& board, double density, unsigned seed) {
+        fillRandom(board, 0, 0, board.getWidth(), board.getHeight(), density, seed);
+    }
+
+    // Calls stepOnce() `generations` times and returns the wall time per call in ms.
+    template <typename Fn>
+    double msPerGeneration(long long generations, Fn&& stepOnce) {
+        const auto start = std::chrono::steady_clock::now();
+        for (long long g = 0; g < generations; ++g) {
+            stepOnce();
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / double(std::max<long long>(generations, 1));
+    }
+
+    // Times `generations` generations of a size x size torus soup for every temporal
+    // blocking depth from 1 (one sweep per generation) to 8, and checks that all depths
+    // agree on the final population.
+    inline int benchmarkTemporalBlocking(int size, long long generations, std::ostream& out) {
+        DenseEngine::Board initial(size, size, DenseEngine::Topology::Torus);
+        fillRandom(initial, 0.35, 12345);
+
+        out << "Temporal blocking, " << size << "x" << size << " torus, " << generations << " generations\n";
+        double baseline = 0.0;
+        size_t expectedPopulation = 0;
+        for (int depth = 1; depth <= 8; ++depth) {
+            DenseEngine::Board board = initial;
+            const auto start = std::chrono::steady_clock::now();
+            board.advance(uint64_t(generations), depth);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            const double perGeneration = elapsed.count() / double(generations);
+            const size_t population = board.population();
+            if (depth == 1) {
+                baseline = perGeneration;
+                expectedPopulation = population;
+            }
+            out << "  k=" << depth << "  " << std::fixed << std::setprecision(3) << perGeneration << " ms/gen  "
+                << std::setprecision(2) << baseline / perGeneration << "x"
+                << (population == expectedPopulation ? "" : "  MISMATCH") << "\n";
+            if (population != expectedPopulation) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // Forks a size x size soup `forks` times, makes a different one-cell edit in each fork and
+    // steps all of them at once, one thread per fork. Reports what forking cost and how many
+    // tiles the forks still share at the end.
+    inline int benchmarkForks(int forks, int size, long long generations, std::ostream& out) {
+        TiledEngine::Universe original;
+        fillRandom(original, 0, 0, size, size, 0.35, 12345);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<TiledEngine::Universe> branches;
+        for (int i = 0; i < forks; ++i) {
+            branches.push_back(original.fork());
+        }
+        const std::chrono::duration<double, std::micro> forkTime = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < forks; ++i) {
+            const int x = (i * 97) % size, y = (i * 57) % size;
+            branches[i].set(x, y, !branches[i].get(x, y));
+        }
+        const std::chrono::duration<double, std::milli> editTime = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (auto& branch : branches) {
+            workers.emplace_back([&branch, generations]() {
+                for (long long g = 0; g < generations; ++g) {
+                    branch.step();
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        const std::chrono::duration<double, std::milli> stepTime = std::chrono::steady_clock::now() - start;
+
+        size_t total = 0;
+        std::unordered_set<const TiledEngine::Tile*> distinct;
+        for (const auto& branch : branches) {
+            total += branch.getTiles().size();
+            for (const auto& entry : branch.getTiles()) {
+                distinct.insert(entry.second.get());
+            }
+        }
+        out << forks << " forks of a " << size << "x" << size << " soup (" << original.getTiles().size() << " tiles)\n"
+            << std::fixed << std::setprecision(1)
+            << "  fork " << forkTime.count() / forks << " us each, first edit " << editTime.count() / forks << " ms each\n"
+            << "  " << generations << " generations on all forks at once in " << stepTime.count() << " ms\n"
+            << "  " << distinct.size() << " distinct tiles behind " << total << " references ("
+            << (total ? 100.0 * (1.0 - double(distinct.size()) / double(total)) : 0.0) << "% shared)\n";
+        return 0;
+    }
+
+    // Steps a size x size soup `generations` times with `workMs` of other work per generation,
+    // standing in for drawing or exporting it, once stepping in line and once taking the
+    // generations from a Lookahead::Speculator computing them in the meantime.
+    inline int benchmarkLookahead(int size, long long generations, int workMs, std::ostream& out) {
+        TiledEngine::Universe initial;
+        initial.setTracking(true);
+        fillRandom(initial, 0, 0, size, size, 0.35, 12345);
+        auto work = [&]() { std::this_thread::sleep_for(std::chrono::milliseconds(workMs)); };
+
+        TiledEngine::Universe plain = initial;
+        const double inline_ = msPerGeneration(generations, [&]() { plain.step(); work(); }) - workMs;
+
+        Lookahead::Speculator speculator;
+        TiledEngine::Universe ahead = initial;
+        speculator.follow(ahead);
+        const double speculative = msPerGeneration(generations, [&]() { speculator.step(ahead); work(); }) - workMs;
+
+        const bool match = plain.getState().hash == ahead.getState().hash && plain.population() == ahead.population();
+        out << "Look-ahead, " << size << "x" << size << " soup, " << generations << " generations, " << workMs << " ms of work each\n"
+            << std::fixed << std::setprecision(3)
+            << "  in line      " << inline_ << " ms/gen waiting for the step\n"
+            << "  look-ahead   " << speculative << " ms/gen waiting for the step, " << speculator.hitCount() << " ready, "
+            << speculator.missCount() << " computed on demand\n"
+            << (match ? "" : "  MISMATCH\n");
+        return match ? 0 : 1;
+    }
+
+    // Watches a 512x512 soup for `generations` generations while `others` more soups lie
+    // `distance` cells away around it, once stepping everything and once with light cone
+    // evaluation, and checks that both show the same cells in the view every generation.
+    inline int benchmarkLightCone(long long generations, int others, int distance, std::ostream& out) {
+        TiledEngine::Universe initial;
+        initial.setTracking(true);
+        fillRandom(initial, 0, 0, 512, 512, 0.35, 12345);
+        for (int i = 0; i < others; ++i) {
+            const double angle = 6.283185307179586 * i / std::max(others, 1);
+            fillRandom(initial, int(distance * std::cos(angle)), int(distance * std::sin(angle)), 512, 512, 0.35, 12346 + unsigned(i));
+        }
+        UniverseHash::BoundingBox view;
+        view.include(0, 0);
+        view.include(511, 511);
+
+        auto viewCells = [&](auto&& forEach) {
+            std::vector<uint64_t> cells;
+            forEach([&](int x, int y) { cells.push_back((uint64_t(uint32_t(y)) << 32) | uint32_t(x)); });
+            std::sort(cells.begin(), cells.end());
+            return cells;
+        };
+
+        TiledEngine::Universe eager = initial;
+        LightCone::Universe lazy(initial);
+        uint64_t eagerTiles = 0;
+        double eagerTime = 0, lazyTime = 0;
+        bool match = true;
+        for (long long g = 1; g <= generations; ++g) {
+            auto start = std::chrono::steady_clock::now();
+            eagerTiles += eager.getTiles().size();
+            eager.step();
+            eagerTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            lazy.advanceTo(uint64_t(g), view);
+            lazyTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            const auto inView = [&](auto&& fn) {
+                eager.forEachAlive([&](int x, int y) {
+                    if (x >= view.minX && x <= view.maxX && y >= view.minY && y <= view.maxY) fn(x, y);
+                });
+            };
+            if (g % 16 == 0 || g == generations) {
+                match = match && viewCells(inView) == viewCells([&](auto&& fn) { lazy.forEachAliveIn(view, fn); });
+            }
+        }
+
+        out << "Light cone, 512x512 view plus " << others << " soups " << distance << " cells away, " << generations << " generations\n"
+            << std::fixed << std::setprecision(1)
+            << "  everything   " << eagerTime << " ms, " << eagerTiles << " tile steps\n"
+            << "  light cone   " << lazyTime << " ms, " << lazy.tileSteps() << " tile steps, " << lazy.frozenCount() << " of "
+            << lazy.regionCount() << " regions frozen\n"
+            << (match ? "" : "  MISMATCH\n");
+        return match ? 0 : 1;
+    }
+
+    // Steps a repetitive board, a size x size field of blinkers with a 256x256 soup in one
+    // corner, with and without a tile store, and reports the step cost, how often the memo
+    // answered and how many tiles the store saved. Checks that both runs end in the same state.
+    inline int benchmarkTileStore(int size, long long generations, std::ostream& out) {
+        TiledEngine::Universe initial;
+        initial.setTracking(true);
+        for (int y = 0; y < size; y += 8) {
+            for (int x = 0; x < size; x += 8) {
+                for (int i = 0; i < 3; ++i) {
+                    initial.set(x + 2 + i, y + 3, true);
+                }
+            }
+        }
+        fillRandom(initial, 0, 0, 256, 256, 0.35, 12345);
+
+        TiledEngine::Universe plain = initial;
+        const double plainTime = msPerGeneration(generations, [&]() { plain.step(); });
+
+        TiledEngine::Universe stored = initial;
+        stored.setTileStore(std::make_shared<TiledEngine::TileStore>());
+        const double storedTime = msPerGeneration(generations, [&]() { stored.step(); });
+
+        const TiledEngine::TileStore::Stats stats = stored.getTileStore()->stats();
+        const TiledEngine::Sharing sharing = TiledEngine::measureSharing(stored);
+        const double lookups = double(std::max<uint64_t>(stats.memoHits + stats.memoMisses, 1));
+        const bool match = plain.getState().hash == stored.getState().hash && plain.population() == stored.population();
+        out << "Tile store, " << size << "x" << size << " blinker field with a 256x256 soup, " << generations << " generations\n"
+            << std::fixed << std::setprecision(3)
+            << "  plain        " << plainTime << " ms/gen, " << plain.getTiles().size() << " tiles\n"
+            << "  tile store   " << storedTime << " ms/gen, memo answered " << std::setprecision(1)
+            << 100.0 * double(stats.memoHits) / lookups << "% of " << uint64_t(lookups) << " tile steps\n"
+            << "  sharing      " << sharing.references << " tiles backed by " << sharing.distinct << " distinct ("
+            << std::setprecision(1) << sharing.ratio() << "x), " << sharing.savedBytes() / 1024 << " KB saved, "
+            << stats.uniqueTiles << " in the store\n"
+            << (match ? "" : "  MISMATCH\n");
+        return match ? 0 : 1;
+    }
+
+    // Steps a 512x512 soup in the middle of a size x size field of scattered blinkers and
+    // gliders with the tiled and the hybrid engine, and compares step cost and memory. Checks
+    // that both end in the same state.
+    inline int benchmarkHybrid(int size, long long generations, std::ostream& out) {
+        TiledEngine::Universe initial;
+        initial.setTracking(true);
+        const int core = size / 2 - 256;
+        fillRandom(initial, core, core, 512, 512, 0.35, 12345);
+        std::mt19937 generator(54321);
+        std::uniform_int_distribution<int> offset(0, 24);
+        for (int y = 0; y < size; y += 32) {
+            for (int x = 0; x < size; x += 32) {
+                if (x >= core - 64 && x < core + 576 && y >= core - 64 && y < core + 576) {
+                    continue;
+                }
+                const int ox = x + offset(generator), oy = y + offset(generator);
+                if (generator() & 1) {
+                    for (int i = 0; i < 3; ++i) initial.set(ox + i, oy, true);
+                }
+                else {
+                    initial.set(ox + 1, oy, true);
+                    initial.set(ox + 2, oy + 1, true);
+                    for (int i = 0; i < 3; ++i) initial.set(ox + i, oy + 2, true);
+                }
+            }
+        }
+
+        TiledEngine::Universe tiled = initial;
+        const double tiledTime = msPerGeneration(generations, [&]() { tiled.step(); });
+        HybridEngine::Universe hybrid(initial);
+        const double hybridTime = msPerGeneration(generations, [&]() { hybrid.step(); });
+
+        const size_t tiledBytes = tiled.getTiles().size() * (sizeof(TiledEngine::Tile) + sizeof(TiledEngine::TileKey) + 4 * sizeof(void*));
+        const HybridEngine::Universe::Stats stats = hybrid.stats();
+        const TiledEngine::Universe result = hybrid.toTiled();
+        const bool match = result.population() == tiled.population() && TiledEngine::Universe(result).getTiles().size() == tiled.getTiles().size() &&
+                           [&]() {
+                               TiledEngine::Universe check = result;
+                               check.setTracking(true);
+                               return check.getState().hash == tiled.getState().hash;
+                           }();
+        out << "Hybrid engine, 512x512 soup in a " << size << "x" << size << " field of blinkers and gliders, " << generations << " generations\n"
+            << std::fixed << std::setprecision(3)
+            << "  tiled        " << tiledTime << " ms/gen, " << tiled.getTiles().size() << " bit tiles, " << tiledBytes / 1024 << " KB\n"
+            << "  hybrid       " << hybridTime << " ms/gen, " << stats.sparseTiles << " lists with " << stats.sparseCells << " cells, "
+            << stats.denseTiles << " bit tiles with " << stats.denseCells << " cells, " << stats.bytes / 1024 << " KB, "
+            << stats.migrations << " conversions\n"
+            << (match ? "" : "  MISMATCH\n");
+        return match ? 0 : 1;
+    }
+
+    // Steps a 512x512 soup in the corner of a 4096x4096 field of blinkers with the hybrid
+    // engine, once with equal bands of tiles per thread and once with the cost-aware
+    // scheduler, and prints each worker's busy and idle time. Checks that both agree.
+    inline int benchmarkBalance(unsigned threads, long long generations, std::ostream& out) {
+        HybridEngine::Universe initial;
+        fillRandom(initial, 0, 0, 512, 512, 0.35, 12345);
+        std::mt19937 generator(54321);
+        std::uniform_int_distribution<int> offset(0, 24);
+        for (int y = 0; y < 4096; y += 32) {
+            for (int x = 0; x < 4096; x += 32) {
+                if (x >= 576 || y >= 576) {
+                    const int ox = x + offset(generator), oy = y + offset(generator);
+                    for (int i = 0; i < 3; ++i) {
+                        initial.set(ox + i, oy, true);
+                    }
+                }
+            }
+        }
+
+        HybridEngine::Universe banded = initial;
+        const double bandedTime = msPerGeneration(generations, [&]() { banded.step(); });
+        HybridEngine::Universe balanced = initial;
+        auto scheduler = std::make_shared<LoadBalance::Scheduler>(threads);
+        balanced.setScheduler(scheduler);
+        const double balancedTime = msPerGeneration(generations, [&]() { balanced.step(); });
+
+        TiledEngine::Universe first = banded.toTiled(), second = balanced.toTiled();
+        first.setTracking(true);
+        second.setTracking(true);
+        const bool match = first.getState().hash == second.getState().hash && first.population() == second.population();
+        out << "Load balance, 512x512 soup in the corner of a 4096x4096 blinker field, " << generations << " generations\n"
+            << std::fixed << std::setprecision(3)
+            << "  bands        " << bandedTime << " ms/gen on " << Parallel::workerCount() << " threads\n"
+            << "  scheduler    " << balancedTime << " ms/gen on " << scheduler->getThreadCount() << " threads, imbalance "
+            << LoadBalance::Scheduler::imbalance(scheduler->total()) << "\n";
+        const std::vector<LoadBalance::WorkerTime>& workers = scheduler->total();
+        for (size_t worker = 0; worker < workers.size(); ++worker) {
+            out << "    worker " << worker << "   busy " << std::setprecision(1) << workers[worker].busyMs << " ms, idle "
+                << workers[worker].idleMs << " ms, " << workers[worker].tiles << " tiles in " << workers[worker].chunks << " chunks, "
+                << workers[worker].steals << " stolen\n";
+        }
+        out << (match ? "" : "  MISMATCH\n");
+        return match ? 0 : 1;
+    }
+
+    // The cells of row y of the distributed benchmark soup, the same in every process.
+    inline uint64_t soupWord(int x, int y) {
+        uint64_t v = (uint64_t(uint32_t(x)) << 32 | uint32_t(y)) * 0x9E3779B97F4A7C15ull;
+        v ^= v >> 31;
+        v *= 0xBF58476D1CE4E5B9ull;
+        v ^= v >> 29;
+        const uint64_t a = v, b = v * 0x94D049BB133111EBull;
+        return a & (b ^ (b >> 27)) & ~(a >> 7);
+    }
+
+    // Fills the part of a size x size soup that lies in `area`.
+    inline void fillSoup(TiledEngine::Universe& universe, const Selection::Rect& area) {
+        for (int ty = area.y / TiledEngine::tileSize; ty < (area.y + area.height) / TiledEngine::tileSize; ++ty) {
+            for (int tx = area.x / TiledEngine::tileSize; tx < (area.x + area.width) / TiledEngine::tileSize; ++tx) {
+                TiledEngine::Tile tile;
+                for (int r = 0; r < TiledEngine::tileSize; ++r) {
+                    tile.rows[r] = soupWord(tx, ty * TiledEngine::tileSize + r);
+                }
+                universe.putTile({ tx, ty }, tile);
+            }
+        }
+    }
+
+    // Runs one rank of a distributed size x size walled soup; start every rank from 0 to
+    // ranks - 1 on this machine. Rank 0 prints compute, communication and barrier time per
+    // step for each rank, and with `verify` set also steps the whole board alone to check
+    // the result.
+    inline int runDistributed(int rank, int ranks, int size, long long generations, int halo, int port, bool verify, std::ostream& out) {
+        try {
+            const int tiles = std::max(size / TiledEngine::tileSize, 1);
+            const Distributed::Layout layout = Distributed::makeLayout(tiles, tiles, ranks);
+            Distributed::Node node(layout, rank, halo, static_cast<unsigned short>(port));
+            fillSoup(node.getUniverse(), node.getDomain());
+            node.getUniverse().recomputeState();
+            node.connect();
+            node.advance(uint64_t(std::max<long long>(generations, 0)));
+            const std::vector<Distributed::Summary> summaries = node.gather();
+            if (rank != 0) {
+                return 0;
+            }
+
+            uint64_t population = 0, hash = 0;
+            out << "Distributed, " << tiles * TiledEngine::tileSize << "x" << tiles * TiledEngine::tileSize << " soup on " << layout.columns << "x"
+                << layout.rows << " ranks, halo " << halo << ", " << generations << " generations\n";
+            for (const Distributed::Summary& summary : summaries) {
+                const double steps = double(std::max<uint64_t>(summary.times.generations, 1));
+                out << std::fixed << std::setprecision(3) << "  rank " << summary.rank << "   compute " << summary.times.computeMs / steps
+                    << " ms/gen, communication " << summary.times.communicationMs / steps << " ms/gen, barrier "
+                    << summary.times.barrierMs / steps << " ms/gen, " << std::setprecision(1)
+                    << double(summary.times.bytesSent) / steps / 1024 << " KB/gen sent\n";
+                population += summary.population;
+                hash += summary.hash;
+            }
+            out << "  population " << population << ", hash " << std::hex << hash << std::dec << "\n";
+            if (!verify) {
+                return 0;
+            }
+            TiledEngine::Universe whole;
+            whole.setBounds(tiles, tiles, TiledEngine::Topology::Wall);
+            fillSoup(whole, { 0, 0, tiles * TiledEngine::tileSize, tiles * TiledEngine::tileSize });
+            whole.setTracking(true);
+            for (long long g = 0; g < generations; ++g) {
+                whole.step();
+            }
+            const bool match = whole.getState().population == population && whole.getState().hash == hash;
+            out << (match ? "  matches a single process\n" : "  MISMATCH with a single process\n");
+            return match ? 0 : 1;
+        }
+        catch (const std::exception& error) {
+            std::cerr << "Rank " << rank << ": " << error.what() << "\n";
+            return 1;
+        }
+    }
+
+    inline bool hasExtension(const std::string& path, const std::string& extension) {
+        return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+    }
+
+    // Loads a checkpoint (.ckpt) or any pattern file PatternImport reads, applying the rule
+    // the file names. Returns a short description of the format.
+    inline std::string loadUniverse(const std::string& path, TiledEngine::Universe& universe) {
+        if (hasExtension(path, ".ckpt")) {
+            Checkpoint::load(path, universe);
+            return "checkpoint, rule " + universe.getRule().toString();
+        }
+        static const char* formatNames[] = { "RLE", "Life 1.05", "Life 1.06", "plaintext", "macrocell", "unknown" };
+        const PatternImport::Info info = PatternImport::load(path, universe);
+        if (!info.rule.empty()) {
+            universe.setRule(LifeKernel::Rule::parse(info.rule));
+        }
+        return std::string(formatNames[int(info.format)]) + ", rule " + (info.rule.empty() ? "unspecified" : info.rule);
+    }
+
+    // Loads a pattern file into the tiled engine and reports what was read and how fast.
+    inline int importPattern(const std::string& path, std::ostream& out) {
+        TiledEngine::Universe universe;
+        const auto start = std::chrono::steady_clock::now();
+        std::string description;
+        try {
+            description = loadUniverse(path, universe);
+        }
+        catch (const std::exception& error) {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        out << path << ": " << description << ", " << universe.getTiles().size() << " tiles loaded in "
+            << std::fixed << std::setprecision(1) << elapsed.count() << " ms, " << universe.population() << " cells\n";
+        return 0;
+    }
+
+    // Loads a pattern file or checkpoint and saves it as RLE, macrocell or a checkpoint, chosen
+    // by the output extension. Checkpoints are compressed unless `raw` is set.
+    inline int convertPattern(const std::string& input, const std::string& output, bool raw, std::ostream& out) {
+        TiledEngine::Universe universe;
+        try {
+            loadUniverse(input, universe);
+            const auto start = std::chrono::steady_clock::now();
+            if (hasExtension(output, ".ckpt")) {
+                Checkpoint::save(output, universe, !raw);
+            }
+            else if (hasExtension(output, ".mc")) {
+                PatternExport::saveMacrocell(output, universe);
+            }
+            else {
+                PatternExport::saveRle(output, universe);
+            }
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            out << output << ": " << universe.population() << " cells written in " << std::fixed << std::setprecision(1)
+                << elapsed.count() << " ms\n";
+        }
+        catch (const std::exception& error) {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    // Runs a pattern with its escaping spaceships collected and reports population, tiles and
+    // step cost along the way, which stay flat for a gun, and what was collected.
+    inline int collectShips(const std::string& path, long long generations, std::ostream& out) {
+        TiledEngine::Universe universe;
+        try {
+            loadUniverse(path, universe);
+        }
+        catch (const std::exception& error) {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+        universe.setTracking(true);
+        const UniverseHash::BoundingBox box = universe.getState().box;
+        if (box.isEmpty()) {
+            std::cerr << path << " is empty\n";
+            return 1;
+        }
+        Sinks::Collector collector({ box.minX, box.minY, box.maxX - box.minX + 1, box.maxY - box.minY + 1 });
+
+        const long long report = std::max<long long>(generations / 10, 1);
+        auto start = std::chrono::steady_clock::now();
+        for (long long g = 1; g <= generations; ++g) {
+            universe.step();
+            collector.collect(universe);
+            if (g % report == 0 || g == generations) {
+                const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                out << "  generation " << g << ": " << universe.getState().population << " cells in " << universe.getTiles().size()
+                    << " tiles, " << std::fixed << std::setprecision(4) << elapsed.count() / double(report) << " ms/gen\n";
+                start = std::chrono::steady_clock::now();
+            }
+        }
+        out << collector.describe() << "\n";
+        return 0;
+    }
+
+    // Indexes a directory of pattern files in place, or packs it into a single archive when
+    // `archive` is given, then reopens the result to check it.
+    inline int buildLibrary(const std::string& directory, const std::string& archive, std::ostream& out) {
+        const std::string output = archive.empty() ? directory + "/" + PatternLibrary::indexName : archive;
+        try {
+            const auto start = std::chrono::steady_clock::now();
+            const PatternLibrary::BuildResult result = PatternLibrary::build(directory, output, !archive.empty());
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            const PatternLibrary::Library library(output);
+            out << output << ": " << library.size() << " patterns indexed, " << result.skipped << " files skipped in "
+                << std::fixed << std::setprecision(1) << elapsed.count() << " ms\n";
+        }
+        catch (const std::exception& error) {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    inline void printUsage(std::ostream& out) {
+        out << "Usage: GameOfLife [mode]\n"
+            << "  --bench-temporal [size=8192] [generations=64]\n"
+            << "  --bench-forks [forks=4] [size=2048] [generations=100]\n"
+            << "  --bench-lookahead [size=1024] [generations=200] [work-ms=5]\n"
+            << "  --bench-lightcone [generations=500] [others=8] [distance=20000]\n"
+            << "  --bench-tilestore [size=4096] [generations=100]\n"
+            << "  --bench-hybrid [size=4096] [generations=100]\n"
+            << "  --bench-balance [threads=all] [generations=100]\n"
+            << "  --distributed <rank> <ranks> [size=4096] [generations=100] [halo=4] [port=52000] [verify=0]\n"
+            << "  --search [soups=10000] [seed=1] [threads=all] [lanes=64]\n"
+            << "  --import <pattern file or .ckpt>\n"
+            << "  --convert <pattern file or .ckpt> <output .rle, .mc or .ckpt> [raw]\n"
+            << "  --build-library <pattern directory> [archive.golpack]\n"
+            << "  --collect <pattern file or .ckpt> [generations=100000]\n";
+    }
+
+    // Runs the headless mode named on the command line. Returns false when no mode was
+    // requested and the caller should start the viewer; otherwise exitCode is set.
+    inline bool run(int argc, char** argv, int& exitCode) {
+        if (argc < 2 || std::string(argv[1]).rfind("--", 0) != 0) {
+            return false;
+        }
+        const std::string mode = argv[1];
+        const std::vector<std::string> args(argv + 2, argv + argc);
+
+        if (mode == "--bench-temporal") {
+            exitCode = benchmarkTemporalBlocking(int(std::max<long long>(argumentOr(args, 0, 8192), 1)),
+                                                 std::max<long long>(argumentOr(args, 1, 64), 1), std::cout);
+        }
+        else if (mode == "--bench-forks") {
+            exitCode = benchmarkForks(int(std::max<long long>(argumentOr(args, 0, 4), 1)), int(std::max<long long>(argumentOr(args, 1, 2048), 1)),
+                                      argumentOr(args, 2, 100), std::cout);
+        }
+        else if (mode == "--bench-lookahead") {
+            exitCode = benchmarkLookahead(int(std::max<long long>(argumentOr(args, 0, 1024), 1)), argumentOr(args, 1, 200),
+                                          int(std::max<long long>(argumentOr(args, 2, 5), 0)), std::cout);
+        }
+        else if (mode == "--bench-lightcone") {
+            exitCode = benchmarkLightCone(argumentOr(args, 0, 500), int(std::max<long long>(argumentOr(args, 1, 8), 0)),
+                                          int(argumentOr(args, 2, 20000)), std::cout);
+        }
+        else if (mode == "--bench-tilestore") {
+            exitCode = benchmarkTileStore(int(std::max<long long>(argumentOr(args, 0, 4096), 256)), argumentOr(args, 1, 100), std::cout);
+        }
+        else if (mode == "--bench-hybrid") {
+            exitCode = benchmarkHybrid(int(std::max<long long>(argumentOr(args, 0, 4096), 1024)), argumentOr(args, 1, 100), std::cout);
+        }
+        else if (mode == "--bench-balance") {
+            const long long threads = argumentOr(args, 0, 0);
+            exitCode = benchmarkBalance(threads > 0 ? unsigned(threads) : Parallel::workerCount(), argumentOr(args, 1, 100), std::cout);
+        }
+        else if (mode == "--distributed" && args.size() >= 2) {
+            exitCode = runDistributed(int(argumentOr(args, 0, 0)), int(argumentOr(args, 1, 1)), int(argumentOr(args, 2, 4096)),
+                                      argumentOr(args, 3, 100), int(argumentOr(args, 4, 4)), int(argumentOr(args, 5, Distributed::defaultPort)),
+                                      argumentOr(args, 6, 0) != 0, std::cout);
+        }
+        else if (mode == "--search") {
+            SoupSearch::Options options;
+            options.soups = uint64_t(argumentOr(args, 0, 10000));
+            options.seed = uint64_t(argumentOr(args, 1, 1));
+            options.threads = unsigned(argumentOr(args, 2, 0));
+            options.lanes = int(argumentOr(args, 3, 64));
+            SoupSearch::printResult(SoupSearch::search(options), std::cout);
+            exitCode = 0;
+        }
+        else if (mode == "--import" && !args.empty()) {
+            exitCode = importPattern(args[0], std::cout);
+        }
+        else if (mode == "--convert" && args.size() >= 2) {
+            exitCode = convertPattern(args[0], args[1], args.size() > 2 && args[2] == "raw", std::cout);
+        }
+        else if (mode == "--collect" && !args.empty()) {
+            exitCode = collectShips(args[0], argumentOr(args, 1, 100000), std::cout);
+        }
+        else if (mode == "--build-library" && !args.empty()) {
+            exitCode = buildLibrary(args[0], args.size() > 1 ? args[1] : "", std::cout);
+        }
+        else {
+            printUsage(mode == "--help" ? std::cout : std::cerr);
+            exitCode = mode == "--help" ? 0 : 2;
+        }
+        return true;
+    }
+
+} // namespace HeadlessRunner
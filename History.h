@@ -0,0 +1,262 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+#include "TiledEngine.h"
+
+// Recorded past of a tiled universe, for scrubbing back through a run and stepping in reverse.
+//
+// Every generation is stored as a delta: for each tile that changed, the rows that changed
+// and the XOR of their old and new words. A set bit is a birth if the cell is alive
+// afterwards and a death otherwise, and since XOR undoes itself the same delta steps
+// forwards and backwards. Every keyframeInterval generations a full copy of the universe is
+// kept as a keyframe; copies share their tiles with the universe, so a keyframe only costs
+// memory for the tiles that have changed since. Any recorded generation is rebuilt from the
+// nearest keyframe at or before it plus at most keyframeInterval - 1 deltas.
+//
+// The oldest keyframe and its deltas are dropped whenever the history grows past its memory
+// budget, so the recorded window slides along with the run like a ring buffer.
+namespace History {
+
+    using TiledEngine::Tile;
+    using TiledEngine::TileKey;
+    using TiledEngine::tileSize;
+
+    // The changed rows of one tile: rowMask marks them, and their XOR words are stored in
+    // order of row index starting at `first` in the owning Delta's words.
+    struct TileDelta {
+        TileKey key;
+        uint32_t first;
+        uint64_t rowMask;
+    };
+
+    // The change from one generation to the next.
+    struct Delta {
+        std::vector<TileDelta> tiles;
+        std::vector<uint64_t> words;
+
+        size_t bytes() const {
+            return sizeof(Delta) + tiles.capacity() * sizeof(TileDelta) + words.capacity() * sizeof(uint64_t);
+        }
+    };
+
+    // The delta that turns `before` into `after`. Tiles the two universes share by reference,
+    // which is every tile a step left alone, are skipped without being compared.
+    inline Delta diff(const TiledEngine::Universe& before, const TiledEngine::Universe& after) {
+        Delta delta;
+        auto add = [&](const TileKey& key, const Tile* from, const Tile* to) {
+            TileDelta tile{ key, uint32_t(delta.words.size()), 0 };
+            for (int r = 0; r < tileSize; ++r) {
+                const uint64_t change = (from ? from->rows[r] : 0) ^ (to ? to->rows[r] : 0);
+                if (change) {
+                    tile.rowMask |= uint64_t(1) << r;
+                    delta.words.push_back(change);
+                }
+            }
+            if (tile.rowMask) {
+                delta.tiles.push_back(tile);
+            }
+        };
+
+        const TiledEngine::TileMap& beforeTiles = before.getTiles();
+        for (const auto& entry : after.getTiles()) {
+            auto it = beforeTiles.find(entry.first);
+            if (it == beforeTiles.end()) {
+                add(entry.first, nullptr, entry.second.get());
+            }
+            else if (it->second != entry.second) {
+                add(entry.first, it->second.get(), entry.second.get());
+            }
+        }
+        for (const auto& entry : beforeTiles) {
+            if (!after.findTile(entry.first)) {
+                add(entry.first, entry.second.get(), nullptr);
+            }
+        }
+        delta.tiles.shrink_to_fit();
+        delta.words.shrink_to_fit();
+        return delta;
+    }
+
+    // Toggles every cell the delta names, which applies it forwards or undoes it.
+    inline void apply(const Delta& delta, TiledEngine::Universe& universe) {
+        for (const TileDelta& change : delta.tiles) {
+            const Tile* current = universe.findTile(change.key);
+            Tile tile = current ? *current : Tile{};
+            uint32_t word = change.first;
+            for (uint64_t rows = change.rowMask; rows; rows &= rows - 1) {
+                tile.rows[LifeKernel::countTrailingZeros(rows)] ^= delta.words[word++];
+            }
+            universe.putTile(change.key, tile);
+        }
+    }
+
+    class Timeline {
+    public:
+        static constexpr size_t defaultBudget = size_t(256) << 20;
+        static constexpr uint64_t defaultKeyframeInterval = 64;
+
+        explicit Timeline(size_t memoryBudget = defaultBudget, uint64_t keyframeInterval = defaultKeyframeInterval)
+            : budget(memoryBudget), interval(std::max<uint64_t>(keyframeInterval, 1)) {
+        }
+
+        // Forgets everything and starts recording from `universe`.
+        void reset(const TiledEngine::Universe& universe) {
+            segments.clear();
+            used = 0;
+            last = universe;
+            startSegment(universe);
+        }
+
+        bool empty() const {
+            return segments.empty();
+        }
+
+        uint64_t earliest() const {
+            return segments.empty() ? 0 : segments.front().keyframe.getGeneration();
+        }
+
+        uint64_t latest() const {
+            return segments.empty() ? 0 : last.getGeneration();
+        }
+
+        size_t memoryUsed() const {
+            return used;
+        }
+
+        // Records `universe` as the generation after the latest one. A universe from inside the
+        // recorded window first cuts off the future it branches from; anything that does not
+        // continue the window restarts the recording.
+        void record(const TiledEngine::Universe& universe) {
+            const uint64_t generation = universe.getGeneration();
+            if (segments.empty() || generation <= earliest() || generation > latest() + 1) {
+                reset(universe);
+                return;
+            }
+            if (generation <= latest()) {
+                truncate(generation - 1);
+            }
+
+            Segment& segment = segments.back();
+            if (generation - segment.keyframe.getGeneration() >= interval) {
+                startSegment(universe);
+            }
+            else {
+                segment.deltas.push_back(diff(last, universe));
+                segment.bytes += segment.deltas.back().bytes();
+                used += segment.deltas.back().bytes();
+            }
+            last = universe;
+            trim();
+        }
+
+        // Rebuilds the recorded `generation` into `universe`, which keeps its own tracking
+        // setting. Throws std::out_of_range for generations outside the recorded window.
+        void reconstruct(uint64_t generation, TiledEngine::Universe& universe) const {
+            const Segment& segment = segmentOf(generation);
+            const bool tracking = universe.isTracking();
+            universe = segment.keyframe;
+            for (uint64_t g = segment.keyframe.getGeneration(); g < generation; ++g) {
+                apply(segment.deltas[size_t(g - segment.keyframe.getGeneration())], universe);
+            }
+            universe.setGeneration(generation);
+            universe.setTracking(tracking);
+        }
+
+        // Moves `universe`, which must hold a recorded generation, one generation back.
+        // Returns false at the start of the window.
+        bool stepBack(TiledEngine::Universe& universe) const {
+            const uint64_t generation = universe.getGeneration();
+            if (generation <= earliest() || generation > latest()) {
+                return false;
+            }
+            const Segment& segment = segmentOf(generation);
+            if (generation == segment.keyframe.getGeneration()) {
+                // The delta into a keyframe is not stored; rebuild from the previous one instead.
+                reconstruct(generation - 1, universe);
+                return true;
+            }
+            apply(segment.deltas[size_t(generation - 1 - segment.keyframe.getGeneration())], universe);
+            universe.setGeneration(generation - 1);
+            return true;
+        }
+
+        // Moves `universe` one generation forward within the window. Returns false at the end.
+        bool stepForward(TiledEngine::Universe& universe) const {
+            const uint64_t generation = universe.getGeneration();
+            if (generation < earliest() || generation >= latest()) {
+                return false;
+            }
+            const Segment& segment = segmentOf(generation);
+            const uint64_t offset = generation - segment.keyframe.getGeneration();
+            if (offset == segment.deltas.size()) {
+                reconstruct(generation + 1, universe);
+                return true;
+            }
+            apply(segment.deltas[size_t(offset)], universe);
+            universe.setGeneration(generation + 1);
+            return true;
+        }
+
+    private:
+        // A keyframe and the deltas of the generations after it, up to the next keyframe.
+        struct Segment {
+            TiledEngine::Universe keyframe;
+            std::vector<Delta> deltas;
+            size_t bytes = 0;
+        };
+
+        void startSegment(const TiledEngine::Universe& universe) {
+            Segment segment;
+            segment.keyframe = universe;
+            segment.keyframe.setTracking(false);
+            segment.keyframe.setRecordingChanges(false);
+            // Counted as if no tile were shared, which they soon stop being as the run moves on.
+            segment.bytes = sizeof(Segment) + universe.getTiles().size() * (sizeof(Tile) + 64);
+            used += segment.bytes;
+            segments.push_back(std::move(segment));
+        }
+
+        const Segment& segmentOf(uint64_t generation) const {
+            if (segments.empty() || generation < earliest() || generation > latest()) {
+                throw std::out_of_range("Generation is outside the recorded history");
+            }
+            // Every segment but the last covers exactly `interval` generations.
+            return segments[std::min<size_t>(size_t((generation - earliest()) / interval), segments.size() - 1)];
+        }
+
+        // Drops the generations after `generation`, which becomes the latest one.
+        void truncate(uint64_t generation) {
+            while (segments.size() > 1 && segments.back().keyframe.getGeneration() > generation) {
+                used -= segments.back().bytes;
+                segments.pop_back();
+            }
+            Segment& segment = segments.back();
+            const size_t keep = size_t(generation - segment.keyframe.getGeneration());
+            while (segment.deltas.size() > keep) {
+                segment.bytes -= segment.deltas.back().bytes();
+                used -= segment.deltas.back().bytes();
+                segment.deltas.pop_back();
+            }
+            reconstruct(generation, last);
+        }
+
+        // Keeps at least the newest segment, so the latest generation is always available.
+        void trim() {
+            while (used > budget && segments.size() > 1) {
+                used -= segments.front().bytes;
+                segments.pop_front();
+            }
+        }
+
+        size_t budget;
+        uint64_t interval;
+        size_t used = 0;
+        std::deque<Segment> segments;
+        TiledEngine::Universe last;
+    };
+
+} // namespace History
@@ -0,0 +1,548 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "LifeKernel.h"
+#include "LoadBalance.h"
+#include "Parallel.h"
+#include "TiledEngine.h"
+
+// An unbounded universe whose 64x64 tiles pick their own representation by density.
+//
+// A tile with few live cells is a sorted list of their positions inside the tile, two bytes
+// per cell. It steps by placing its cells, and those of its neighbours within one cell of
+// it, in row words and running the word kernel over only the rows they can reach, which
+// yields the next list in order. A crowded tile is a 64x64 bit tile as in TiledEngine and
+// steps over all 64 rows. The kernel follows the centre tile; a neighbour in the other
+// representation only supplies the strip of cells next to the edge.
+//
+// After every step and edit a list that grew past denseAbove cells becomes a bit tile, and a
+// bit tile that fell below sparseBelow becomes a list. The gap between the two keeps tiles
+// on the edge of a chaotic region, or holding an oscillator near the threshold, from being
+// converted back and forth every generation. Debris fields thus cost a few bytes per cell
+// and a few operations per cell, while dense cores keep the speed of the bit kernel.
+//
+// Bounded universes and B0 rules are left to TiledEngine.
+namespace HybridEngine {
+
+    using LifeKernel::Rule;
+    using TiledEngine::TileKey;
+    using TiledEngine::TileKeyHash;
+    using TiledEngine::tileCoord;
+    using TiledEngine::inTile;
+    using TiledEngine::tileSize;
+
+    // Position of a cell inside its tile, y * 64 + x, so that sorted lists run row by row.
+    inline uint16_t cellIndex(int x, int y) {
+        return uint16_t((y << 6) | x);
+    }
+
+    // One tile in either representation: `bits` is set for a dense tile and `cells` is used
+    // otherwise.
+    struct Tile {
+        std::vector<uint16_t> cells;
+        std::unique_ptr<TiledEngine::Tile> bits;
+
+        Tile() = default;
+        Tile(Tile&&) = default;
+        Tile& operator=(Tile&&) = default;
+
+        Tile(const Tile& other)
+            : cells(other.cells), bits(other.bits ? std::make_unique<TiledEngine::Tile>(*other.bits) : nullptr) {
+        }
+
+        Tile& operator=(const Tile& other) {
+            if (this != &other) {
+                *this = Tile(other);
+            }
+            return *this;
+        }
+
+        bool isDense() const {
+            return bits != nullptr;
+        }
+
+        size_t population() const {
+            return bits ? bits->population() : cells.size();
+        }
+
+        bool isEmpty() const {
+            return bits ? bits->isEmpty() : cells.empty();
+        }
+
+        bool get(int x, int y) const {
+            if (bits) {
+                return (bits->rows[y] >> x) & 1;
+            }
+            return std::binary_search(cells.begin(), cells.end(), cellIndex(x, y));
+        }
+
+        // Bytes held by the tile's cells, not counting the map entry.
+        size_t bytes() const {
+            return sizeof(Tile) + (bits ? sizeof(TiledEngine::Tile) : cells.capacity() * sizeof(uint16_t));
+        }
+
+        TiledEngine::Tile toBits() const {
+            if (bits) {
+                return *bits;
+            }
+            TiledEngine::Tile result;
+            for (uint16_t cell : cells) {
+                result.rows[cell >> 6] |= uint64_t(1) << (cell & 63);
+            }
+            return result;
+        }
+
+        void makeDense() {
+            if (!bits) {
+                bits = std::make_unique<TiledEngine::Tile>(toBits());
+                cells.clear();
+                cells.shrink_to_fit();
+            }
+        }
+
+        void makeSparse() {
+            if (!bits) {
+                return;
+            }
+            cells.clear();
+            cells.reserve(bits->population());
+            for (int r = 0; r < tileSize; ++r) {
+                for (uint64_t row = bits->rows[r]; row; row &= row - 1) {
+                    cells.push_back(cellIndex(LifeKernel::countTrailingZeros(row), r));
+                }
+            }
+            bits.reset();
+        }
+    };
+
+    using TileMap = std::unordered_map<TileKey, Tile, TileKeyHash>;
+
+    class Universe {
+    public:
+        // A list of 96 cells touches most rows of its tile, so it steps no faster than a bit
+        // tile while it already takes a third of its memory.
+        static constexpr size_t defaultDenseAbove = 96;
+        static constexpr size_t defaultSparseBelow = 32;
+
+        // Where tiles are counted and what their cells cost, for comparing with TiledEngine.
+        struct Stats {
+            size_t sparseTiles = 0;
+            size_t denseTiles = 0;
+            size_t sparseCells = 0;
+            size_t denseCells = 0;
+            size_t bytes = 0;
+            // Tiles converted so far, by steps and edits alike.
+            uint64_t migrations = 0;
+        };
+
+        explicit Universe(Rule rule = Rule::conway()) {
+            setRule(rule);
+        }
+
+        // Takes the cells, rule and generation of a tiled universe.
+        explicit Universe(const TiledEngine::Universe& source) {
+            if (source.isBounded()) {
+                throw std::invalid_argument("HybridEngine only runs unbounded universes");
+            }
+            setRule(source.getRule());
+            generation = source.getGeneration();
+            for (const auto& entry : source.getTiles()) {
+                Tile tile;
+                tile.bits = std::make_unique<TiledEngine::Tile>(*entry.second);
+                settle(tile);
+                tiles.emplace(entry.first, std::move(tile));
+            }
+            migrations = 0;
+        }
+
+        const Rule& getRule() const {
+            return rule;
+        }
+
+        void setRule(const Rule& newRule) {
+            if (newRule.birth & 1) {
+                throw std::invalid_argument("HybridEngine does not run B0 rules");
+            }
+            rule = newRule;
+        }
+
+        // Tiles become dense above `denseAbove` cells and sparse below `sparseBelow`.
+        void setThresholds(size_t denseAbove, size_t sparseBelow) {
+            if (sparseBelow > denseAbove) {
+                throw std::invalid_argument("HybridEngine needs sparseBelow <= denseAbove");
+            }
+            upper = denseAbove;
+            lower = sparseBelow;
+            for (auto& entry : tiles) {
+                settle(entry.second);
+            }
+        }
+
+        bool get(int x, int y) const {
+            const auto it = tiles.find({ tileCoord(x), tileCoord(y) });
+            return it != tiles.end() && it->second.get(inTile(x), inTile(y));
+        }
+
+        void set(int x, int y, bool alive) {
+            const TileKey key{ tileCoord(x), tileCoord(y) };
+            const int cx = inTile(x), cy = inTile(y);
+            if (get(x, y) == alive) {
+                return;
+            }
+            Tile& tile = tiles[key];
+            if (tile.bits) {
+                tile.bits->rows[cy] ^= uint64_t(1) << cx;
+            }
+            else if (alive) {
+                const uint16_t cell = cellIndex(cx, cy);
+                tile.cells.insert(std::lower_bound(tile.cells.begin(), tile.cells.end(), cell), cell);
+            }
+            else {
+                tile.cells.erase(std::lower_bound(tile.cells.begin(), tile.cells.end(), cellIndex(cx, cy)));
+            }
+            if (tile.isEmpty()) {
+                tiles.erase(key);
+                return;
+            }
+            settle(tile);
+        }
+
+        void clear() {
+            tiles.clear();
+        }
+
+        size_t population() const {
+            size_t count = 0;
+            for (const auto& entry : tiles) {
+                count += entry.second.population();
+            }
+            return count;
+        }
+
+        uint64_t getGeneration() const {
+            return generation;
+        }
+
+        void setGeneration(uint64_t value) {
+            generation = value;
+        }
+
+        const TileMap& getTiles() const {
+            return tiles;
+        }
+
+        // Calls fn(x, y) for every live cell, tile by tile.
+        template <typename Fn>
+        void forEachAlive(Fn&& fn) const {
+            for (const auto& entry : tiles) {
+                const int originX = entry.first.x * tileSize;
+                const int originY = entry.first.y * tileSize;
+                if (entry.second.bits) {
+                    for (int r = 0; r < tileSize; ++r) {
+                        for (uint64_t row = entry.second.bits->rows[r]; row; row &= row - 1) {
+                            fn(originX + LifeKernel::countTrailingZeros(row), originY + r);
+                        }
+                    }
+                }
+                else {
+                    for (uint16_t cell : entry.second.cells) {
+                        fn(originX + (cell & 63), originY + (cell >> 6));
+                    }
+                }
+            }
+        }
+
+        // The same cells as a tiled universe, e.g. for drawing or saving.
+        TiledEngine::Universe toTiled() const {
+            TiledEngine::Universe result(rule);
+            result.setGeneration(generation);
+            for (const auto& entry : tiles) {
+                result.putTile(entry.first, entry.second.toBits());
+            }
+            return result;
+        }
+
+        Stats stats() const {
+            Stats result;
+            result.migrations = migrations;
+            for (const auto& entry : tiles) {
+                const Tile& tile = entry.second;
+                (tile.isDense() ? result.denseTiles : result.sparseTiles) += 1;
+                (tile.isDense() ? result.denseCells : result.sparseCells) += tile.population();
+                result.bytes += tile.bytes() + sizeof(TileKey) + 2 * sizeof(void*);
+            }
+            return result;
+        }
+
+        // Spreads the tiles of each step over the scheduler's workers by their measured cost;
+        // lists and bit tiles differ widely in cost. Pass null to go back to equal bands.
+        void setScheduler(std::shared_ptr<LoadBalance::Scheduler> tileScheduler) {
+            scheduler = std::move(tileScheduler);
+        }
+
+        const std::shared_ptr<LoadBalance::Scheduler>& getScheduler() const {
+            return scheduler;
+        }
+
+        // Advances the universe by one generation.
+        void step() {
+            const std::vector<TileKey> candidates = collectCandidates();
+            std::vector<Tile> results(candidates.size());
+            auto computeTile = [&](size_t i) {
+                const Tile* center = findTile(candidates[i]);
+                if (center && center->isDense()) {
+                    results[i].bits = std::make_unique<TiledEngine::Tile>(denseNext(candidates[i]));
+                }
+                else {
+                    results[i].cells = sparseNext(candidates[i]);
+                }
+            };
+            if (scheduler) {
+                scheduler->forEach(candidates, [&](size_t i, unsigned) { computeTile(i); });
+            }
+            else {
+                Parallel::forRange(0, candidates.size(), [&](size_t first, size_t last) {
+                    for (size_t i = first; i < last; ++i) {
+                        computeTile(i);
+                    }
+                });
+            }
+
+            TileMap next;
+            next.reserve(results.size());
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                Tile& tile = results[i];
+                if (tile.isEmpty()) {
+                    continue;
+                }
+                settle(tile);
+                next.emplace(candidates[i], std::move(tile));
+            }
+            tiles.swap(next);
+            ++generation;
+        }
+
+    private:
+        const Tile* findTile(const TileKey& key) const {
+            const auto it = tiles.find(key);
+            return it == tiles.end() ? nullptr : &it->second;
+        }
+
+        // Converts a tile whose count left the band of its representation.
+        void settle(Tile& tile) {
+            const size_t count = tile.population();
+            if (tile.isDense() && count < lower) {
+                tile.makeSparse();
+                ++migrations;
+            }
+            else if (!tile.isDense() && count > upper) {
+                tile.makeDense();
+                ++migrations;
+            }
+        }
+
+        // Live tiles plus every neighbour that a live cell on one of their edges touches.
+        std::vector<TileKey> collectCandidates() const {
+            std::vector<TileKey> candidates;
+            candidates.reserve(tiles.size() * 2);
+            for (const auto& entry : tiles) {
+                const TileKey& key = entry.first;
+                const Tile& tile = entry.second;
+                bool north, south, west, east, northWest, northEast, southWest, southEast;
+                if (tile.bits) {
+                    const auto& rows = tile.bits->rows;
+                    uint64_t columns = 0;
+                    for (uint64_t row : rows) {
+                        columns |= row;
+                    }
+                    west = columns & 1;
+                    east = columns >> 63;
+                    north = rows[0] != 0;
+                    south = rows[tileSize - 1] != 0;
+                    northWest = rows[0] & 1;
+                    northEast = rows[0] >> 63;
+                    southWest = rows[tileSize - 1] & 1;
+                    southEast = rows[tileSize - 1] >> 63;
+                }
+                else {
+                    north = (tile.cells.front() >> 6) == 0;
+                    south = (tile.cells.back() >> 6) == tileSize - 1;
+                    west = east = false;
+                    for (uint16_t cell : tile.cells) {
+                        west = west || (cell & 63) == 0;
+                        east = east || (cell & 63) == tileSize - 1;
+                    }
+                    northWest = tile.get(0, 0);
+                    northEast = tile.get(tileSize - 1, 0);
+                    southWest = tile.get(0, tileSize - 1);
+                    southEast = tile.get(tileSize - 1, tileSize - 1);
+                }
+
+                candidates.push_back(key);
+                if (north) candidates.push_back({ key.x, key.y - 1 });
+                if (south) candidates.push_back({ key.x, key.y + 1 });
+                if (west) candidates.push_back({ key.x - 1, key.y });
+                if (east) candidates.push_back({ key.x + 1, key.y });
+                if (northWest) candidates.push_back({ key.x - 1, key.y - 1 });
+                if (northEast) candidates.push_back({ key.x + 1, key.y - 1 });
+                if (southWest) candidates.push_back({ key.x - 1, key.y + 1 });
+                if (southEast) candidates.push_back({ key.x + 1, key.y + 1 });
+            }
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+            return candidates;
+        }
+
+        // Calls fn(x, y) for the cells of the neighbour at (dx, dy) that lie within one cell of
+        // the centre tile, in the centre tile's coordinates (-1 to 64).
+        template <typename Fn>
+        static void forEachEdgeCell(const Tile& tile, int dx, int dy, Fn&& fn) {
+            const int offsetX = dx * tileSize, offsetY = dy * tileSize;
+            const int onlyX = dx < 0 ? tileSize - 1 : 0;
+            const int onlyY = dy < 0 ? tileSize - 1 : 0;
+            if (tile.bits) {
+                const uint64_t mask = dx == 0 ? ~uint64_t(0) : uint64_t(1) << onlyX;
+                const int firstRow = dy == 0 ? 0 : onlyY, lastRow = dy == 0 ? tileSize - 1 : onlyY;
+                for (int r = firstRow; r <= lastRow; ++r) {
+                    for (uint64_t row = tile.bits->rows[r] & mask; row; row &= row - 1) {
+                        fn(LifeKernel::countTrailingZeros(row) + offsetX, r + offsetY);
+                    }
+                }
+                return;
+            }
+            auto first = tile.cells.begin(), last = tile.cells.end();
+            if (dy != 0) {
+                first = std::lower_bound(first, last, cellIndex(0, onlyY));
+                last = std::lower_bound(first, last, uint16_t(cellIndex(0, onlyY) + tileSize));
+            }
+            for (auto it = first; it != last; ++it) {
+                const int x = *it & 63;
+                if (dx == 0 || x == onlyX) {
+                    fn(x + offsetX, (*it >> 6) + offsetY);
+                }
+            }
+        }
+
+        // The next cells of a sparse or new tile. Its cells and the edge cells of its neighbours
+        // are set in a halo of row words, and the word kernel runs over just the rows they can
+        // reach, so the cost follows the rows in use rather than the tile's area.
+        std::vector<uint16_t> sparseNext(const TileKey& key) const {
+            // Index r + 1 holds row r; `left` and `right` hold the cells at x = -1 and x = 64.
+            uint64_t center[tileSize + 2] = {};
+            uint64_t left[tileSize + 2] = {};
+            uint64_t right[tileSize + 2] = {};
+            uint64_t usedLow = 0, usedHigh = 0;
+            auto add = [&](int x, int y) {
+                const int r = y + 1;
+                if (x < 0) {
+                    left[r] = 1;
+                }
+                else if (x >= tileSize) {
+                    right[r] = 1;
+                }
+                else {
+                    center[r] |= uint64_t(1) << x;
+                }
+                // Output row y depends on halo rows y - 1 to y + 1, i.e. indices r - 1 to r + 1.
+                for (int out = y - 1; out <= y + 1; ++out) {
+                    if (out >= 0 && out < tileSize) {
+                        (out < 32 ? usedLow : usedHigh) |= uint64_t(1) << (out & 31);
+                    }
+                }
+            };
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    if (const Tile* tile = findTile({ key.x + dx, key.y + dy })) {
+                        forEachEdgeCell(*tile, dx, dy, add);
+                    }
+                }
+            }
+
+            std::vector<uint16_t> result;
+            auto stepRow = [&](int r) {
+                uint64_t row = LifeKernel::nextWord(center[r] << 1 | left[r], center[r], center[r] >> 1 | right[r] << 63,
+                                                    center[r + 1] << 1 | left[r + 1], center[r + 1], center[r + 1] >> 1 | right[r + 1] << 63,
+                                                    center[r + 2] << 1 | left[r + 2], center[r + 2], center[r + 2] >> 1 | right[r + 2] << 63,
+                                                    rule);
+                for (; row; row &= row - 1) {
+                    result.push_back(cellIndex(LifeKernel::countTrailingZeros(row), r));
+                }
+            };
+            for (uint64_t rows = usedLow; rows; rows &= rows - 1) {
+                stepRow(LifeKernel::countTrailingZeros(rows));
+            }
+            for (uint64_t rows = usedHigh; rows; rows &= rows - 1) {
+                stepRow(32 + LifeKernel::countTrailingZeros(rows));
+            }
+            return result;
+        }
+
+        // The next cells of a dense tile, from the word kernel over a halo of its neighbours.
+        TiledEngine::Tile denseNext(const TileKey& key) const {
+            // Rows of the neighbours by (dy + 1) * 3 + dx + 1; sparse ones are unpacked.
+            std::array<TiledEngine::Tile, 9> unpacked;
+            std::array<const TiledEngine::Tile*, 9> around{};
+            static const TiledEngine::Tile emptyTile{};
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const int index = (dy + 1) * 3 + dx + 1;
+                    const Tile* tile = findTile({ key.x + dx, key.y + dy });
+                    if (!tile) {
+                        around[index] = &emptyTile;
+                    }
+                    else if (tile->bits) {
+                        around[index] = tile->bits.get();
+                    }
+                    else {
+                        forEachEdgeCell(*tile, dx, dy, [&](int x, int y) {
+                            unpacked[index].rows[y - dy * tileSize] |= uint64_t(1) << (x - dx * tileSize);
+                        });
+                        around[index] = &unpacked[index];
+                    }
+                }
+            }
+
+            // Index r + 1 holds tile row r; indices 0 and 65 are the halo rows.
+            uint64_t center[tileSize + 2];
+            uint64_t west[tileSize + 2];
+            uint64_t east[tileSize + 2];
+            for (int r = 0; r < tileSize; ++r) {
+                const uint64_t c = around[4]->rows[r];
+                west[r + 1] = LifeKernel::westOf(c, around[3]->rows[r]);
+                east[r + 1] = LifeKernel::eastOf(c, around[5]->rows[r]);
+                center[r + 1] = c;
+            }
+            const uint64_t top = around[1]->rows[tileSize - 1];
+            west[0] = LifeKernel::westOf(top, around[0]->rows[tileSize - 1]);
+            east[0] = LifeKernel::eastOf(top, around[2]->rows[tileSize - 1]);
+            center[0] = top;
+            const uint64_t bottom = around[7]->rows[0];
+            west[tileSize + 1] = LifeKernel::westOf(bottom, around[6]->rows[0]);
+            east[tileSize + 1] = LifeKernel::eastOf(bottom, around[8]->rows[0]);
+            center[tileSize + 1] = bottom;
+
+            TiledEngine::Tile result;
+            for (int r = 0; r < tileSize; ++r) {
+                result.rows[r] = LifeKernel::nextWord(west[r], center[r], east[r],
+                                                      west[r + 1], center[r + 1], east[r + 1],
+                                                      west[r + 2], center[r + 2], east[r + 2], rule);
+            }
+            return result;
+        }
+
+        TileMap tiles;
+        Rule rule;
+        uint64_t generation = 0;
+        size_t upper = defaultDenseAbove;
+        size_t lower = defaultSparseBelow;
+        uint64_t migrations = 0;
+        std::shared_ptr<LoadBalance::Scheduler> scheduler;
+    };
+
+} // namespace HybridEngine
@@ -0,0 +1,289 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "Fft.h"
+#include "Parallel.h"
+
+namespace LeniaEngine {
+
+    // Parameters of a Lenia world. The kernel is a ring of radius `radius` cells whose
+    // profile is made of one bump per entry of `peaks`, and the growth mapping is a
+    // Gaussian centred on `mu` with width `sigma`. The defaults produce Orbium. `radius` and
+    // `sigma` must be positive and `peaks` may not be empty.
+    struct Params {
+        int radius = 13;
+        float mu = 0.15f;
+        float sigma = 0.015f;
+        float dt = 0.1f;
+        std::vector<float> peaks = { 1.0f };
+    };
+
+    // Smooth bump used for every kernel ring, zero at both ends of (0, 1) and one at its centre.
+    inline float kernelCore(float r) {
+        if (r <= 0.0f || r >= 1.0f) {
+            return 0.0f;
+        }
+        return std::exp(4.0f - 1.0f / (r * (1.0f - r)));
+    }
+
+    // Maps a neighbourhood potential to a growth rate in [-1, 1].
+    inline float growth(float potential, const Params& params) {
+        const float d = (potential - params.mu) / params.sigma;
+        return 2.0f * std::exp(-0.5f * d * d) - 1.0f;
+    }
+
+    // A real-valued toroidal field of size width x height evolving under Lenia rules.
+    // Each step convolves the field with the kernel and applies the growth mapping.
+    // Large kernels go through a 2D FFT (O(N log N) per step) with a precomputed kernel
+    // spectrum; small kernels, where the transform would cost more than the taps, use a
+    // direct convolution over a halo-padded copy of the field. Both sizes must be powers of two.
+    class Field {
+    public:
+        Field(size_t width, size_t height, Params params = Params())
+            : width(width), height(height), params(checked(std::move(params))), plan(width, height),
+              cells(width * height, 0.0f), spectrum(width * height) {
+            buildKernel();
+        }
+
+        size_t getWidth() const {
+            return width;
+        }
+
+        size_t getHeight() const {
+            return height;
+        }
+
+        const Params& getParams() const {
+            return params;
+        }
+
+        void setParams(Params newParams) {
+            params = checked(std::move(newParams));
+            buildKernel();
+        }
+
+        // True when steps run through the FFT path rather than the direct convolution.
+        bool usesFft() const {
+            return useFft;
+        }
+
+        float get(int x, int y) const {
+            return cells[size_t(y) * width + size_t(x)];
+        }
+
+        bool contains(int x, int y) const {
+            return x >= 0 && y >= 0 && size_t(x) < width && size_t(y) < height;
+        }
+
+        const std::vector<float>& values() const {
+            return cells;
+        }
+
+        void clear() {
+            std::fill(cells.begin(), cells.end(), 0.0f);
+        }
+
+        // Fills a disc of the given radius around (centerX, centerY) with uniform noise.
+        // Random patches of about the kernel size are the usual way to grow Lenia creatures.
+        void seedNoise(int centerX, int centerY, int radius, unsigned seed) {
+            std::mt19937 generator(seed);
+            std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+            for (int dy = -radius; dy <= radius; ++dy) {
+                for (int dx = -radius; dx <= radius; ++dx) {
+                    if (dx * dx + dy * dy > radius * radius) {
+                        continue;
+                    }
+                    const int x = centerX + dx;
+                    const int y = centerY + dy;
+                    if (contains(x, y)) {
+                        cells[size_t(y) * width + size_t(x)] = distribution(generator);
+                    }
+                }
+            }
+        }
+
+        // Advances the field by one time step of length params.dt.
+        void step() {
+            if (useFft) {
+                stepFft();
+            }
+            else {
+                stepDirect();
+            }
+        }
+
+    private:
+        static Params checked(Params candidate) {
+            if (candidate.radius <= 0) {
+                throw std::invalid_argument("LeniaEngine::Params needs a positive kernel radius");
+            }
+            if (!(candidate.sigma > 0.0f)) {
+                throw std::invalid_argument("LeniaEngine::Params needs a positive growth width");
+            }
+            if (candidate.peaks.empty()) {
+                throw std::invalid_argument("LeniaEngine::Params needs at least one kernel peak");
+            }
+            return candidate;
+        }
+
+        struct Tap {
+            std::ptrdiff_t offset;
+            float weight;
+        };
+
+        // Samples the kernel, normalises it to unit mass and prepares whichever
+        // convolution path is cheaper for this kernel and field size.
+        void buildKernel() {
+            const int radius = params.radius;
+            const float rings = float(params.peaks.size());
+            std::vector<std::pair<std::pair<int, int>, float>> samples;
+            float total = 0.0f;
+            for (int dy = -radius; dy <= radius; ++dy) {
+                for (int dx = -radius; dx <= radius; ++dx) {
+                    const float r = std::sqrt(float(dx * dx + dy * dy)) / float(radius);
+                    if (r >= 1.0f) {
+                        continue;
+                    }
+                    const float scaled = r * rings;
+                    const size_t ring = std::min(params.peaks.size() - 1, size_t(scaled));
+                    const float weight = params.peaks[ring] * kernelCore(scaled - float(ring));
+                    if (weight > 0.0f) {
+                        samples.push_back({ { dx, dy }, weight });
+                        total += weight;
+                    }
+                }
+            }
+
+            double log2Cells = std::log2(double(width) * double(height));
+            useFft = double(samples.size()) > 5.0 * log2Cells;
+
+            paddedWidth = width + 2 * size_t(radius);
+            taps.clear();
+            kernelSpectrum.assign(width * height, Fft::Complex());
+            const float scale = 1.0f / (total * float(width * height));
+            for (const auto& sample : samples) {
+                const int dx = sample.first.first;
+                const int dy = sample.first.second;
+                taps.push_back({ std::ptrdiff_t(dy) * std::ptrdiff_t(paddedWidth) + dx, sample.second / total });
+                const size_t x = size_t((dx + int(width)) % int(width));
+                const size_t y = size_t((dy + int(height)) % int(height));
+                // The inverse transform is unscaled, so 1/N is folded into the kernel spectrum.
+                kernelSpectrum[y * width + x] += Fft::Complex(sample.second * scale, 0.0f);
+            }
+            if (useFft) {
+                plan.transform(kernelSpectrum, false);
+            }
+        }
+
+        void stepFft() {
+            Parallel::forRange(0, cells.size(), [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    spectrum[i] = Fft::Complex(cells[i], 0.0f);
+                }
+            }, 4096);
+            plan.transform(spectrum, false);
+            Parallel::forRange(0, spectrum.size(), [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    spectrum[i] *= kernelSpectrum[i];
+                }
+            }, 4096);
+            plan.transform(spectrum, true);
+            Parallel::forRange(0, cells.size(), [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    cells[i] = std::clamp(cells[i] + params.dt * growth(spectrum[i].real(), params), 0.0f, 1.0f);
+                }
+            }, 4096);
+        }
+
+        // Direct convolution for small kernels. The field is first copied into a buffer with a
+        // toroidal halo of `radius` cells so that the tap loop needs no wrapping or bounds checks.
+        void stepDirect() {
+            const size_t radius = size_t(params.radius);
+            padded.resize(paddedWidth * (height + 2 * radius));
+            for (size_t py = 0; py < height + 2 * radius; ++py) {
+                const size_t y = (py + height - radius % height) % height;
+                const float* source = &cells[y * width];
+                float* destination = &padded[py * paddedWidth];
+                for (size_t px = 0; px < paddedWidth; ++px) {
+                    destination[px] = source[(px + width - radius % width) % width];
+                }
+            }
+
+            potential.resize(cells.size());
+            Parallel::forRange(0, height, [&](size_t first, size_t last) {
+                for (size_t y = first; y < last; ++y) {
+                    const float* center = &padded[(y + radius) * paddedWidth + radius];
+                    for (size_t x = 0; x < width; ++x) {
+                        float sum = 0.0f;
+                        for (const Tap& tap : taps) {
+                            sum += center[std::ptrdiff_t(x) + tap.offset] * tap.weight;
+                        }
+                        potential[y * width + x] = sum;
+                    }
+                }
+            }, 8);
+
+            for (size_t i = 0; i < cells.size(); ++i) {
+                cells[i] = std::clamp(cells[i] + params.dt * growth(potential[i], params), 0.0f, 1.0f);
+            }
+        }
+
+        size_t width;
+        size_t height;
+        Params params;
+        bool useFft = true;
+
+        Fft::Plan2D plan;
+        std::vector<float> cells;
+        std::vector<Fft::Complex> spectrum;
+        std::vector<Fft::Complex> kernelSpectrum;
+
+        size_t paddedWidth = 0;
+        std::vector<Tap> taps;
+        std::vector<float> padded;
+        std::vector<float> potential;
+    };
+
+    // Draws a Field on the world grid through a single texture upload per frame.
+    // Every cell becomes one texel, and the sprite is scaled so that a texel covers exactly
+    // one grid square, which keeps the field aligned with the pan/zoom view of the discrete game.
+    class FieldRenderer {
+    public:
+        void update(const Field& field) {
+            const size_t width = field.getWidth();
+            const size_t height = field.getHeight();
+            if (texture.getSize().x != width || texture.getSize().y != height) {
+                texture.create(unsigned(width), unsigned(height));
+                sprite.setTexture(texture, true);
+            }
+
+            pixels.resize(width * height * 4);
+            const std::vector<float>& values = field.values();
+            for (size_t i = 0; i < values.size(); ++i) {
+                pixels[i * 4 + 0] = 118;
+                pixels[i * 4 + 1] = 171;
+                pixels[i * 4 + 2] = 174;
+                pixels[i * 4 + 3] = sf::Uint8(values[i] * 255.0f);
+            }
+            texture.update(pixels.data());
+        }
+
+        void draw(sf::RenderWindow& window, float gridSpacing) {
+            sprite.setPosition(0, 0);
+            sprite.setScale(gridSpacing, gridSpacing);
+            window.draw(sprite);
+        }
+
+    private:
+        sf::Texture texture;
+        sf::Sprite sprite;
+        std::vector<sf::Uint8> pixels;
+    };
+
+} // namespace LeniaEngine
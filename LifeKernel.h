@@ -0,0 +1,184 @@
+#pragma once
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace LifeKernel {
+
+    // An outer-totalistic rule in B/S notation. Bit n of `birth` is set when a dead cell
+    // with n live neighbours is born, bit n of `survive` when a live cell with n live
+    // neighbours stays alive. Conway's Game of Life is B3/S23.
+    struct Rule {
+        uint16_t birth = 1 << 3;
+        uint16_t survive = (1 << 2) | (1 << 3);
+
+        static Rule conway() {
+            return Rule();
+        }
+
+        // Parses rules written as "B3/S23" (case-insensitive, either order) or in the
+        // older "23/3" survival/birth form.
+        static Rule parse(const std::string& text) {
+            Rule rule{ 0, 0 };
+            const bool slashOnly = text.find_first_of("bBsS") == std::string::npos;
+            uint16_t* target = slashOnly ? &rule.survive : nullptr;
+            for (char c : text) {
+                if (c == 'b' || c == 'B') {
+                    target = &rule.birth;
+                }
+                else if (c == 's' || c == 'S') {
+                    target = &rule.survive;
+                }
+                else if (c == '/') {
+                    target = slashOnly ? &rule.birth : nullptr;
+                }
+                else if (c >= '0' && c <= '8' && target) {
+                    *target |= uint16_t(1 << (c - '0'));
+                }
+                else if (!std::isspace(static_cast<unsigned char>(c))) {
+                    throw std::invalid_argument("Unsupported rule: " + text);
+                }
+            }
+            return rule;
+        }
+
+        bool isConway() const {
+            return birth == (1 << 3) && survive == ((1 << 2) | (1 << 3));
+        }
+
+        bool operator==(const Rule& other) const {
+            return birth == other.birth && survive == other.survive;
+        }
+
+        bool operator!=(const Rule& other) const {
+            return !(*this == other);
+        }
+
+        std::string toString() const {
+            std::string text = "B";
+            for (int n = 0; n <= 8; ++n) {
+                if (birth & (1 << n)) text += char('0' + n);
+            }
+            text += "/S";
+            for (int n = 0; n <= 8; ++n) {
+                if (survive & (1 << n)) text += char('0' + n);
+            }
+            return text;
+        }
+    };
+
+    // How a bounded universe treats its edges. Torus wraps both axes, the Klein bottle
+    // wraps horizontally and mirrors the row when wrapping vertically, the cross-surface
+    // mirrors on both axes, and Wall keeps everything beyond the edges permanently dead.
+    enum class Topology {
+        Torus,
+        KleinBottle,
+        CrossSurface,
+        Wall
+    };
+
+    // Number of set bits in a word, i.e. the live cells it holds.
+    inline int popcount(uint64_t word) {
+#if defined(_MSC_VER)
+        return int(__popcnt64(word));
+#else
+        return __builtin_popcountll(word);
+#endif
+    }
+
+    // Index of the lowest set bit; word must not be zero.
+    inline int countTrailingZeros(uint64_t word) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return int(index);
+#else
+        return __builtin_ctzll(word);
+#endif
+    }
+
+    // Mirrors a 64-bit word so that bit 0 becomes bit 63.
+    inline uint64_t reverseBits(uint64_t word) {
+        word = ((word >> 1) & 0x5555555555555555ull) | ((word & 0x5555555555555555ull) << 1);
+        word = ((word >> 2) & 0x3333333333333333ull) | ((word & 0x3333333333333333ull) << 2);
+        word = ((word >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((word & 0x0F0F0F0F0F0F0F0Full) << 4);
+        word = ((word >> 8) & 0x00FF00FF00FF00FFull) | ((word & 0x00FF00FF00FF00FFull) << 8);
+        word = ((word >> 16) & 0x0000FFFF0000FFFFull) | ((word & 0x0000FFFF0000FFFFull) << 16);
+        return (word >> 32) | (word << 32);
+    }
+
+    // Word of left neighbours for a row word: bit x holds the cell at x - 1.
+    // `previous` is the word holding the 64 cells to the left of `word`.
+    inline uint64_t westOf(uint64_t word, uint64_t previous) {
+        return (word << 1) | (previous >> 63);
+    }
+
+    // Word of right neighbours for a row word: bit x holds the cell at x + 1.
+    inline uint64_t eastOf(uint64_t word, uint64_t next) {
+        return (word >> 1) | (next << 63);
+    }
+
+    // Counts the eight neighbour words of 64 cells at once with a bit-sliced adder network,
+    // producing the count in four bit planes, and applies the rule to the centre word.
+    // There are no branches on cell data, so the compiler can keep everything in registers
+    // and unroll or vectorise loops built around it.
+    inline uint64_t nextWord(uint64_t northWest, uint64_t north, uint64_t northEast,
+                             uint64_t west, uint64_t center, uint64_t east,
+                             uint64_t southWest, uint64_t south, uint64_t southEast,
+                             const Rule& rule) {
+        // Three full adders reduce the eight inputs to weights 1 and 2.
+        const uint64_t t0 = northWest ^ north;
+        const uint64_t sum0 = t0 ^ northEast;
+        const uint64_t carry0 = (northWest & north) | (t0 & northEast);
+        const uint64_t t1 = west ^ east;
+        const uint64_t sum1 = t1 ^ southWest;
+        const uint64_t carry1 = (west & east) | (t1 & southWest);
+        const uint64_t sum2 = south ^ southEast;
+        const uint64_t carry2 = south & southEast;
+
+        const uint64_t t2 = sum0 ^ sum1;
+        const uint64_t bit0 = t2 ^ sum2;
+        const uint64_t carry3 = (sum0 & sum1) | (t2 & sum2);
+
+        // Four weight-2 carries reduce to bits 1, 2 and 3 of the count.
+        const uint64_t t3 = carry0 ^ carry1;
+        const uint64_t twos = t3 ^ carry2;
+        const uint64_t carry4 = (carry0 & carry1) | (t3 & carry2);
+        const uint64_t bit1 = twos ^ carry3;
+        const uint64_t carry5 = twos & carry3;
+        const uint64_t bit2 = carry4 ^ carry5;
+        const uint64_t bit3 = carry4 & carry5;
+
+        if (rule.isConway()) {
+            return bit1 & ~bit2 & ~bit3 & (bit0 | center);
+        }
+
+        uint64_t result = 0;
+        for (int n = 0; n <= 8; ++n) {
+            const bool born = (rule.birth >> n) & 1;
+            const bool stays = (rule.survive >> n) & 1;
+            if (!born && !stays) {
+                continue;
+            }
+            const uint64_t match = ((n & 1) ? bit0 : ~bit0) & ((n & 2) ? bit1 : ~bit1)
+                                 & ((n & 4) ? bit2 : ~bit2) & ((n & 8) ? bit3 : ~bit3);
+            result |= match & ((born ? ~center : 0) | (stays ? center : 0));
+        }
+        return result;
+    }
+
+    // Convenience overload that derives the shifted neighbour words from three
+    // consecutive words of each of the rows above, at and below the centre word.
+    inline uint64_t nextWord(const uint64_t* above, const uint64_t* row, const uint64_t* below, const Rule& rule) {
+        return nextWord(westOf(above[1], above[0]), above[1], eastOf(above[1], above[2]),
+                        westOf(row[1], row[0]), row[1], eastOf(row[1], row[2]),
+                        westOf(below[1], below[0]), below[1], eastOf(below[1], below[2]),
+                        rule);
+    }
+
+} // namespace LifeKernel
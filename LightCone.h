@@ -0,0 +1,218 @@
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "TiledEngine.h"
+#include "UniverseHash.h"
+
+// Lazy evaluation of an unbounded universe: only what can affect the view is stepped.
+//
+// The live tiles are split into regions, each a tiled universe with its own generation
+// counter. Nothing moves faster than one cell per generation, so a region whose cells fit in
+// a box at generation g keeps all of its cells inside that box grown by t - g cells up to any
+// later generation t. That grown box is the region's light cone. As long as the cones of two
+// regions stay at least three cells apart, no cell ever has neighbours in both of them, and
+// each evolves exactly as it would alone. Two regions whose cones come closer are brought to
+// a common generation and merged first.
+//
+// Advancing to a generation then only steps the regions whose cone reaches the view by then;
+// the rest stay frozen, however many tiles they hold, until the view or another region
+// comes close enough to matter. The cells inside the view are exact at every generation.
+//
+// The generation counters belong to regions rather than single tiles, since tiles that
+// touch need each other at every generation anyway. Bounded universes and B0 rules, whose
+// cells do not stay inside a cone, are rejected.
+namespace LightCone {
+
+    using Box = UniverseHash::BoundingBox;
+
+    class Universe {
+    public:
+        // Splits `start` into regions of touching tiles.
+        explicit Universe(const TiledEngine::Universe& start) : generation(start.getGeneration()) {
+            if (start.isBounded() || (start.getRule().birth & 1)) {
+                throw std::invalid_argument("Light cone evaluation needs an unbounded universe without B0");
+            }
+
+            // Flood fill over the 8-neighbourhood of tiles
+            std::unordered_map<TiledEngine::TileKey, size_t, TiledEngine::TileKeyHash> component;
+            std::vector<TiledEngine::TileKey> stack;
+            for (const auto& entry : start.getTiles()) {
+                if (component.count(entry.first)) {
+                    continue;
+                }
+                Region region;
+                region.cells = TiledEngine::Universe(start.getRule());
+                region.cells.setGeneration(generation);
+                const size_t index = regions.size();
+                component[entry.first] = index;
+                stack.push_back(entry.first);
+                while (!stack.empty()) {
+                    const TiledEngine::TileKey key = stack.back();
+                    stack.pop_back();
+                    region.cells.putTile(key, start.getTiles().at(key));
+                    for (int dy = -1; dy <= 1; ++dy) {
+                        for (int dx = -1; dx <= 1; ++dx) {
+                            const TiledEngine::TileKey next{ key.x + dx, key.y + dy };
+                            if (start.findTile(next) && !component.count(next)) {
+                                component[next] = index;
+                                stack.push_back(next);
+                            }
+                        }
+                    }
+                }
+                region.cells.setTracking(true);
+                regions.push_back(std::move(region));
+            }
+            mergeConflicts(generation);
+        }
+
+        // The generation the view was last advanced to.
+        uint64_t getGeneration() const {
+            return generation;
+        }
+
+        // Makes the cells inside `view` exact at `target`, which may not lie in the past.
+        // Calling it again with the same generation and a moved view catches up the regions
+        // the new view can see.
+        void advanceTo(uint64_t target, const Box& view) {
+            if (target < generation) {
+                throw std::invalid_argument("Light cone evaluation cannot go back in time");
+            }
+            mergeConflicts(target);
+            for (Region& region : regions) {
+                if (intersects(cone(region, target), view)) {
+                    stepTo(region, target);
+                }
+            }
+            removeEmpty();
+            generation = target;
+        }
+
+        // Calls fn(x, y) for every live cell inside `view`, which must be the last view passed
+        // to advanceTo or lie within it.
+        template <typename Fn>
+        void forEachAliveIn(const Box& view, Fn&& fn) const {
+            for (const Region& region : regions) {
+                if (region.cells.getGeneration() != generation || !intersects(region.cells.getState().box, view)) {
+                    continue;
+                }
+                region.cells.forEachAlive([&](int x, int y) {
+                    if (x >= view.minX && x <= view.maxX && y >= view.minY && y <= view.maxY) {
+                        fn(x, y);
+                    }
+                });
+            }
+        }
+
+        // Brings every region to the current generation and returns them as one universe.
+        TiledEngine::Universe collect() {
+            mergeConflicts(generation);
+            TiledEngine::Universe result(regions.empty() ? TiledEngine::Rule::conway() : regions.front().cells.getRule());
+            result.setGeneration(generation);
+            for (Region& region : regions) {
+                stepTo(region, generation);
+                for (const auto& entry : region.cells.getTiles()) {
+                    result.mergeTile(entry.first, *entry.second);
+                }
+            }
+            return result;
+        }
+
+        size_t regionCount() const {
+            return regions.size();
+        }
+
+        // Regions still behind the current generation.
+        size_t frozenCount() const {
+            return size_t(std::count_if(regions.begin(), regions.end(),
+                                        [&](const Region& region) { return region.cells.getGeneration() < generation; }));
+        }
+
+        // Tiles stepped so far, summed over every step of every region.
+        uint64_t tileSteps() const {
+            return steppedTiles;
+        }
+
+    private:
+        struct Region {
+            TiledEngine::Universe cells;
+        };
+
+        static Box grown(const Box& box, uint64_t by) {
+            if (box.isEmpty()) {
+                return box;
+            }
+            const long long d = (long long)std::min<uint64_t>(by, uint64_t(INT_MAX / 4));
+            Box result;
+            result.minX = int(std::max<long long>((long long)box.minX - d, INT_MIN / 2));
+            result.minY = int(std::max<long long>((long long)box.minY - d, INT_MIN / 2));
+            result.maxX = int(std::min<long long>((long long)box.maxX + d, INT_MAX / 2));
+            result.maxY = int(std::min<long long>((long long)box.maxY + d, INT_MAX / 2));
+            return result;
+        }
+
+        // Everywhere the region's cells can be at any generation up to `target`.
+        static Box cone(const Region& region, uint64_t target) {
+            const uint64_t at = region.cells.getGeneration();
+            return grown(region.cells.getState().box, target > at ? target - at : 0);
+        }
+
+        static bool intersects(const Box& a, const Box& b) {
+            return !a.isEmpty() && !b.isEmpty() && a.minX <= b.maxX && b.minX <= a.maxX && a.minY <= b.maxY && b.minY <= a.maxY;
+        }
+
+        // Cells of the two boxes are at least three apart, so no cell sees both.
+        static bool apart(const Box& a, const Box& b) {
+            return !intersects(grown(a, 2), b);
+        }
+
+        void stepTo(Region& region, uint64_t target) {
+            while (region.cells.getGeneration() < target && region.cells.getState().population) {
+                steppedTiles += region.cells.getTiles().size();
+                region.cells.step();
+            }
+            region.cells.setGeneration(std::max(region.cells.getGeneration(), target));
+        }
+
+        // Merges regions until every pair of cones up to `horizon` is apart. Both regions of
+        // a pair can reach the later of their generations on their own, since their cones
+        // were apart up to the previous horizon.
+        void mergeConflicts(uint64_t horizon) {
+            bool merged = true;
+            while (merged) {
+                merged = false;
+                for (size_t i = 0; i < regions.size() && !merged; ++i) {
+                    for (size_t j = i + 1; j < regions.size() && !merged; ++j) {
+                        if (apart(cone(regions[i], horizon), cone(regions[j], horizon))) {
+                            continue;
+                        }
+                        const uint64_t common = std::max(regions[i].cells.getGeneration(), regions[j].cells.getGeneration());
+                        stepTo(regions[i], common);
+                        stepTo(regions[j], common);
+                        for (const auto& entry : regions[j].cells.getTiles()) {
+                            regions[i].cells.mergeTile(entry.first, *entry.second);
+                        }
+                        regions.erase(regions.begin() + j);
+                        merged = true;
+                    }
+                }
+            }
+        }
+
+        void removeEmpty() {
+            regions.erase(std::remove_if(regions.begin(), regions.end(),
+                                         [](const Region& region) { return region.cells.getState().population == 0; }),
+                          regions.end());
+        }
+
+        std::vector<Region> regions;
+        uint64_t generation;
+        uint64_t steppedTiles = 0;
+    };
+
+} // namespace LightCone
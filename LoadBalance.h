@@ -0,0 +1,288 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Parallel.h"
+
+// Cost-aware scheduling of the tiles of a step over worker threads.
+//
+// Parallel::forRange gives every thread the same number of tiles in key order, i.e. a band of
+// rows. That is fair while every tile costs the same, but a cell list in a debris field, a
+// tile answered by the tile store's memo and a crowded bit tile differ by orders of
+// magnitude, so when the activity sits in one corner one band does nearly all the work.
+//
+// The scheduler times every tile it runs and keeps the times until the next step, which uses
+// them as estimates; tiles it has not seen are charged the average. Each step it orders the
+// tiles along a Hilbert curve, which keeps neighbouring tiles together for the caches, cuts
+// the curve into chunks of equal estimated cost, and deals consecutive chunks to each worker.
+// A worker that runs out of chunks steals the last one of the worker with the most left, so
+// errors in the estimates cost at most a chunk per worker.
+//
+// Busy and idle time per worker are kept for the last step and in total, to check the
+// balance. One scheduler runs one step at a time; forks that share it take turns.
+namespace LoadBalance {
+
+    // Position of (x, y) along a Hilbert curve over the square of side 2^order.
+    inline uint64_t hilbertIndex(uint32_t x, uint32_t y, int order = 32) {
+        uint64_t d = 0;
+        for (uint32_t s = order > 0 ? uint32_t(1) << (order - 1) : 0; s > 0; s >>= 1) {
+            const uint32_t rx = (x & s) ? 1 : 0;
+            const uint32_t ry = (y & s) ? 1 : 0;
+            d += uint64_t(s) * s * ((3 * rx) ^ ry);
+            if (ry == 0) {
+                if (rx == 1) {
+                    x = s - 1 - (x & (s - 1));
+                    y = s - 1 - (y & (s - 1));
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+
+    struct WorkerTime {
+        double busyMs = 0;
+        double idleMs = 0;
+        uint64_t tiles = 0;
+        uint64_t chunks = 0;
+        uint64_t steals = 0;
+    };
+
+    class Scheduler {
+    public:
+        static constexpr size_t defaultChunksPerThread = 8;
+
+        explicit Scheduler(unsigned threads = Parallel::workerCount(), size_t chunksPerThread = defaultChunksPerThread)
+            : threadCount(std::max(threads, 1u)), chunksPerThread(std::max<size_t>(chunksPerThread, 1)) {
+        }
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        unsigned getThreadCount() const {
+            return threadCount;
+        }
+
+        // Calls fn(i, worker) once for every index of `keys`, whose elements have int members
+        // x and y, spread over the workers. `worker` is below getThreadCount() and lets the
+        // caller keep per-worker results without locking.
+        template <typename Key, typename Fn>
+        void forEach(const std::vector<Key>& keys, Fn&& fn) {
+            std::lock_guard<std::mutex> running(runMutex);
+            const auto start = Clock::now();
+            const size_t count = keys.size();
+            if (count == 0) {
+                return;
+            }
+
+            // Order along a curve just large enough for the keys, and look up the estimates.
+            int minX = keys[0].x, minY = keys[0].y, maxX = minX, maxY = minY;
+            for (const Key& key : keys) {
+                minX = std::min(minX, key.x);
+                minY = std::min(minY, key.y);
+                maxX = std::max(maxX, key.x);
+                maxY = std::max(maxY, key.y);
+            }
+            const uint32_t span = std::max(uint32_t(maxX) - uint32_t(minX), uint32_t(maxY) - uint32_t(minY));
+            int curveOrder = 0;
+            while (curveOrder < 32 && (uint64_t(1) << curveOrder) <= span) {
+                ++curveOrder;
+            }
+            // Past 65536 tiles across, neighbouring tiles share a point of a coarser curve, so
+            // that the position and the index fit in one word and sort as one.
+            const int coarse = std::max(curveOrder - 16, 0);
+            std::vector<uint64_t> curve(count);
+            for (size_t i = 0; i < count; ++i) {
+                const uint32_t x = (uint32_t(keys[i].x) - uint32_t(minX)) >> coarse;
+                const uint32_t y = (uint32_t(keys[i].y) - uint32_t(minY)) >> coarse;
+                curve[i] = (hilbertIndex(x, y, curveOrder - coarse) << 32) | i;
+            }
+            std::sort(curve.begin(), curve.end());
+
+            // Estimates by key index. Engines pass their keys sorted, so each lookup starts
+            // where the last one ended.
+            const float fallback = costs.empty() ? 1.0f : float(totalCost / double(costs.size()));
+            std::vector<float> estimates(count);
+            auto cursor = costs.begin();
+            for (size_t i = 0; i < count; ++i) {
+                const uint64_t key = packKey(keys[i].x, keys[i].y);
+                if (cursor != costs.begin() && std::prev(cursor)->first >= key) {
+                    cursor = costs.begin();
+                }
+                if (cursor == costs.end() || cursor->first != key) {
+                    cursor = std::lower_bound(cursor, costs.end(), std::make_pair(key, 0.0f));
+                }
+                const bool known = cursor != costs.end() && cursor->first == key;
+                estimates[i] = known ? cursor->second : fallback;
+                cursor += known;
+            }
+            std::vector<uint32_t> order(count);
+            double total = 0;
+            for (size_t i = 0; i < count; ++i) {
+                order[i] = uint32_t(curve[i]);
+                total += estimates[order[i]];
+            }
+
+            // Chunks of equal estimated cost, consecutive ones dealt to the same worker.
+            const size_t workers = std::min<size_t>(threadCount, count);
+            const double target = total / double(workers * chunksPerThread);
+            std::vector<std::deque<Chunk>> queues(workers);
+            double accumulated = 0;
+            double nextCut = target;
+            size_t chunkStart = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const float estimate = estimates[order[i]];
+                accumulated += estimate;
+                if (accumulated >= nextCut || i + 1 == count) {
+                    const size_t owner = std::min<size_t>(size_t((accumulated - estimate / 2) / total * double(workers)), workers - 1);
+                    queues[owner].push_back({ chunkStart, i + 1 });
+                    chunkStart = i + 1;
+                    while (nextCut <= accumulated) {
+                        nextCut += target;
+                    }
+                }
+            }
+
+            std::vector<float> measured(count);
+            std::vector<std::mutex> locks(workers);
+            last.assign(threadCount, WorkerTime());
+            auto work = [&](size_t worker) {
+                WorkerTime& time = last[worker];
+                Chunk chunk;
+                while (take(queues, locks, worker, chunk, time)) {
+                    const auto began = Clock::now();
+                    auto tileStart = began;
+                    for (size_t i = chunk.first; i < chunk.last; ++i) {
+                        fn(size_t(order[i]), unsigned(worker));
+                        const auto tileEnd = Clock::now();
+                        // At least a nanosecond, so that every estimate counts.
+                        measured[order[i]] = std::max(1.0f, std::chrono::duration<float, std::nano>(tileEnd - tileStart).count());
+                        tileStart = tileEnd;
+                    }
+                    time.busyMs += std::chrono::duration<double, std::milli>(tileStart - began).count();
+                    time.tiles += chunk.last - chunk.first;
+                    ++time.chunks;
+                }
+            };
+            std::vector<std::thread> pool;
+            pool.reserve(workers - 1);
+            for (size_t worker = 1; worker < workers; ++worker) {
+                pool.emplace_back(work, worker);
+            }
+            work(0);
+            for (auto& thread : pool) {
+                thread.join();
+            }
+
+            const double wall = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            totals.resize(threadCount);
+            for (size_t worker = 0; worker < threadCount; ++worker) {
+                last[worker].idleMs = std::max(0.0, wall - last[worker].busyMs);
+                totals[worker].busyMs += last[worker].busyMs;
+                totals[worker].idleMs += last[worker].idleMs;
+                totals[worker].tiles += last[worker].tiles;
+                totals[worker].chunks += last[worker].chunks;
+                totals[worker].steals += last[worker].steals;
+            }
+
+            // Only the tiles of this step are kept, so the table follows the universe.
+            costs.resize(count);
+            totalCost = 0;
+            for (size_t i = 0; i < count; ++i) {
+                costs[i] = { packKey(keys[i].x, keys[i].y), measured[i] };
+                totalCost += measured[i];
+            }
+            if (!std::is_sorted(costs.begin(), costs.end())) {
+                std::sort(costs.begin(), costs.end());
+            }
+        }
+
+        // Per worker, for the last step.
+        const std::vector<WorkerTime>& lastStep() const {
+            return last;
+        }
+
+        // Per worker, summed over every step since the last reset.
+        const std::vector<WorkerTime>& total() const {
+            return totals;
+        }
+
+        void resetTimes() {
+            last.clear();
+            totals.clear();
+        }
+
+        // Longest busy time over the mean busy time, for `times`; 1 is a perfect balance.
+        static double imbalance(const std::vector<WorkerTime>& times) {
+            double longest = 0, sum = 0;
+            for (const WorkerTime& time : times) {
+                longest = std::max(longest, time.busyMs);
+                sum += time.busyMs;
+            }
+            return sum > 0 ? longest * double(times.size()) / sum : 1.0;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // Positions [first, last) along the curve.
+        struct Chunk {
+            size_t first = 0;
+            size_t last = 0;
+        };
+
+        // Orders like tile keys: by y, then x.
+        static uint64_t packKey(int x, int y) {
+            return (uint64_t(uint32_t(y) ^ 0x80000000u) << 32) | (uint32_t(x) ^ 0x80000000u);
+        }
+
+        // Takes the next chunk of `worker`, or steals the last chunk of the worker with the
+        // most left. Returns false once every queue is empty.
+        static bool take(std::vector<std::deque<Chunk>>& queues, std::vector<std::mutex>& locks, size_t worker, Chunk& chunk, WorkerTime& time) {
+            {
+                std::lock_guard<std::mutex> lock(locks[worker]);
+                if (!queues[worker].empty()) {
+                    chunk = queues[worker].front();
+                    queues[worker].pop_front();
+                    return true;
+                }
+            }
+            while (true) {
+                size_t victim = queues.size(), most = 0;
+                for (size_t other = 0; other < queues.size(); ++other) {
+                    std::lock_guard<std::mutex> lock(locks[other]);
+                    if (queues[other].size() > most) {
+                        most = queues[other].size();
+                        victim = other;
+                    }
+                }
+                if (victim == queues.size()) {
+                    return false;
+                }
+                std::lock_guard<std::mutex> lock(locks[victim]);
+                if (!queues[victim].empty()) {
+                    chunk = queues[victim].back();
+                    queues[victim].pop_back();
+                    ++time.steals;
+                    return true;
+                }
+            }
+        }
+
+        const unsigned threadCount;
+        const size_t chunksPerThread;
+        std::mutex runMutex;
+        // Measured nanoseconds per tile of the last step, sorted by key.
+        std::vector<std::pair<uint64_t, float>> costs;
+        double totalCost = 0;
+        std::vector<WorkerTime> last;
+        std::vector<WorkerTime> totals;
+    };
+
+} // namespace LoadBalance
@@ -0,0 +1,207 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TiledEngine.h"
+
+// Speculative computation of the generations that come next, on a background thread.
+//
+// The service follows one universe state at a time and keeps up to `depth` generations after
+// it ready in a queue. Since a fork is O(1) and forks can step concurrently, the worker steps
+// its own fork while the caller keeps using, editing and drawing theirs. When the caller
+// asks for the next generation and the queue continues their exact state, the answer is a
+// fork of a ready snapshot and costs nothing; otherwise it is computed on the spot and the
+// queue restarts from the result.
+//
+// Whether the queue still applies is decided by identity, not by comparing cells: the state
+// it follows is a fork of the caller's universe, so an edit, a rule change or anything else
+// that modifies the caller's universe makes the two stop sharing their tile map, which
+// discards the queue the next time it is consulted.
+//
+// Ready snapshots share every tile that did not change, so each one is charged only for the
+// tiles it added. The worker pauses once the queue is full or over its memory budget.
+namespace Lookahead {
+
+    class Speculator {
+    public:
+        static constexpr size_t defaultDepth = 16;
+        static constexpr size_t defaultBudget = size_t(128) << 20;
+
+        explicit Speculator(size_t depth = defaultDepth, size_t memoryBudget = defaultBudget)
+            : depth(std::max<size_t>(depth, 1)), budget(memoryBudget), worker([this]() { run(); }) {
+        }
+
+        ~Speculator() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            worker.join();
+        }
+
+        Speculator(const Speculator&) = delete;
+        Speculator& operator=(const Speculator&) = delete;
+
+        // Starts precomputing the generations after `universe` unless that is already under way.
+        // Cheap enough to call every frame.
+        void follow(const TiledEngine::Universe& universe) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!follows(universe)) {
+                restart(universe);
+            }
+        }
+
+        // Moves `universe` one generation forward, from the queue when it holds that generation.
+        // Returns true when it did.
+        bool step(TiledEngine::Universe& universe) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (follows(universe) && !ready.empty()) {
+                    const bool tracking = universe.isTracking();
+                    // Freeing the replaced tile map is left to the worker.
+                    retired.push_back(universe);
+                    universe = ready.front().universe;
+                    if (universe.isTracking() != tracking) {
+                        universe.setTracking(tracking);
+                    }
+                    used -= ready.front().bytes;
+                    ready.pop_front();
+                    base = universe.fork();
+                    ++hits;
+                    wake.notify_all();
+                    return true;
+                }
+            }
+            universe.step();
+            std::lock_guard<std::mutex> lock(mutex);
+            ++misses;
+            restart(universe);
+            return false;
+        }
+
+        // Drops everything computed so far, e.g. before the caller changes the universe in a way
+        // that keeps its tile map, such as a new rule.
+        void invalidate() {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++epoch;
+            active = false;
+            clearReady();
+        }
+
+        // Generations ready after the followed state.
+        size_t readyCount() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return ready.size();
+        }
+
+        size_t memoryUsed() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return used;
+        }
+
+        uint64_t hitCount() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return hits;
+        }
+
+        uint64_t missCount() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return misses;
+        }
+
+    private:
+        struct Snapshot {
+            TiledEngine::Universe universe;
+            size_t bytes;
+        };
+
+        bool follows(const TiledEngine::Universe& universe) const {
+            return active && universe.sharesTilesWith(base) && universe.getGeneration() == base.getGeneration() &&
+                   universe.getRule() == base.getRule();
+        }
+
+        void restart(const TiledEngine::Universe& universe) {
+            ++epoch;
+            clearReady();
+            base = universe.fork();
+            active = true;
+            wake.notify_all();
+        }
+
+        void clearReady() {
+            ready.clear();
+            used = 0;
+        }
+
+        bool wanted() const {
+            return active && ready.size() < depth && used < budget;
+        }
+
+        // What a snapshot adds to the one before it: the tiles it does not share, plus its map.
+        static size_t addedBytes(const TiledEngine::Universe& previous, const TiledEngine::Universe& next) {
+            const TiledEngine::TileMap& before = previous.getTiles();
+            size_t added = 0;
+            for (const auto& entry : next.getTiles()) {
+                const auto it = before.find(entry.first);
+                if (it == before.end() || it->second != entry.second) {
+                    ++added;
+                }
+            }
+            return sizeof(Snapshot) + added * (sizeof(TiledEngine::Tile) + 32) + next.getTiles().size() * 32;
+        }
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                wake.wait(lock, [this]() { return stopping || wanted() || !retired.empty(); });
+                if (stopping) {
+                    return;
+                }
+                if (!retired.empty()) {
+                    std::vector<TiledEngine::Universe> released;
+                    released.swap(retired);
+                    lock.unlock();
+                    released.clear();
+                    lock.lock();
+                    continue;
+                }
+                const uint64_t startEpoch = epoch;
+                const TiledEngine::Universe from = ready.empty() ? base.fork() : ready.back().universe.fork();
+                lock.unlock();
+
+                TiledEngine::Universe next = from.fork();
+                next.step();
+                const size_t bytes = addedBytes(from, next);
+
+                lock.lock();
+                if (epoch == startEpoch) {
+                    used += bytes;
+                    ready.push_back({ std::move(next), bytes });
+                }
+            }
+        }
+
+        const size_t depth;
+        const size_t budget;
+        mutable std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping = false;
+        bool active = false;
+        uint64_t epoch = 0;
+        TiledEngine::Universe base;
+        std::deque<Snapshot> ready;
+        std::vector<TiledEngine::Universe> retired;
+        size_t used = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        // Declared last so that it starts once everything it reads is initialized.
+        std::thread worker;
+    };
+
+} // namespace Lookahead
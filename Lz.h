@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// A small LZ77 byte compressor in the style of LZ4: the output is a sequence of
+// (literals, match) pairs, each starting with a token byte whose high nibble is the literal
+// count and low nibble the match length minus 4, with 15 meaning "more length bytes follow".
+// A match is a 16-bit distance back into the output, so runs such as the empty rows of a
+// tile compress to a few bytes. Compression uses one hash table probe per position and
+// decompression is a plain copy loop; both are meant for blocks of a few kilobytes.
+namespace Lz {
+
+    constexpr size_t minMatch = 4;
+    constexpr size_t maxDistance = 65535;
+
+    inline uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline void putLength(std::vector<uint8_t>& out, size_t length) {
+        while (length >= 255) {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back(uint8_t(length));
+    }
+
+    // Appends the compressed form of [input, input + size) to `out`.
+    inline void compress(const uint8_t* input, size_t size, std::vector<uint8_t>& out) {
+        constexpr int hashBits = 12;
+        uint32_t table[1 << hashBits] = {};
+        auto hash = [](uint32_t value) { return (value * 2654435761u) >> (32 - hashBits); };
+
+        size_t literalStart = 0;
+        size_t position = 0;
+        auto emit = [&](size_t matchLength, size_t distance) {
+            const size_t literals = position - literalStart;
+            const size_t extra = matchLength ? matchLength - minMatch : 0;
+            out.push_back(uint8_t((literals < 15 ? literals : 15) << 4 | (extra < 15 ? extra : 15)));
+            if (literals >= 15) putLength(out, literals - 15);
+            out.insert(out.end(), input + literalStart, input + position);
+            if (matchLength) {
+                out.push_back(uint8_t(distance));
+                out.push_back(uint8_t(distance >> 8));
+                if (extra >= 15) putLength(out, extra - 15);
+            }
+        };
+
+        while (position + minMatch <= size) {
+            const uint32_t value = read32(input + position);
+            uint32_t& slot = table[hash(value)];
+            const size_t candidate = slot;
+            slot = uint32_t(position + 1);
+            if (candidate == 0 || position - (candidate - 1) > maxDistance || read32(input + candidate - 1) != value) {
+                ++position;
+                continue;
+            }
+            const size_t from = candidate - 1;
+            size_t length = minMatch;
+            while (position + length < size && input[from + length] == input[position + length]) {
+                ++length;
+            }
+            emit(length, position - from);
+            position += length;
+            literalStart = position;
+        }
+        position = size;
+        if (literalStart < size || out.empty()) {
+            emit(0, 0);
+        }
+    }
+
+    // Decompresses into exactly `size` bytes at `output`. Returns false if the input is
+    // malformed or does not produce exactly that many bytes.
+    inline bool decompress(const uint8_t* input, size_t inputSize, uint8_t* output, size_t size) {
+        const uint8_t* in = input;
+        const uint8_t* inEnd = input + inputSize;
+        size_t written = 0;
+        auto readLength = [&](size_t length) -> size_t {
+            if (length != 15) {
+                return length;
+            }
+            uint8_t byte;
+            do {
+                if (in == inEnd) return size_t(-1);
+                byte = *in++;
+                length += byte;
+            } while (byte == 255);
+            return length;
+        };
+
+        while (in < inEnd) {
+            const uint8_t token = *in++;
+            const size_t literals = readLength(token >> 4);
+            if (literals == size_t(-1) || literals > size_t(inEnd - in) || literals > size - written) {
+                return false;
+            }
+            std::memcpy(output + written, in, literals);
+            in += literals;
+            written += literals;
+            if (in == inEnd) {
+                break;
+            }
+            if (inEnd - in < 2) {
+                return false;
+            }
+            const size_t distance = size_t(in[0]) | (size_t(in[1]) << 8);
+            in += 2;
+            const size_t extra = readLength(token & 15);
+            if (extra == size_t(-1) || distance == 0 || distance > written || extra + minMatch > size - written) {
+                return false;
+            }
+            // Byte by byte, since the source may overlap the bytes being written.
+            for (size_t i = 0; i < extra + minMatch; ++i, ++written) {
+                output[written] = output[written - distance];
+            }
+        }
+        return written == size;
+    }
+
+} // namespace Lz
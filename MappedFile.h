@@ -0,0 +1,138 @@
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A memory mapping of a whole file. Readers parse straight out of the page cache instead of
+// copying the file into a buffer first, and pages they never touch are never read.
+//
+// A private mapping can also be written to: the first write to a page gives the process its
+// own copy of that page, and the file itself is never modified.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path, bool privateWrites = false) {
+#if defined(_WIN32)
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        length = size_t(fileSize.QuadPart);
+        if (length > 0) {
+            mapping = CreateFileMappingA(file, nullptr, privateWrites ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+            bytes = mapping ? static_cast<char*>(MapViewOfFile(mapping, privateWrites ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            if (!bytes) {
+                close();
+                throw std::runtime_error("Cannot map " + path);
+            }
+        }
+#else
+        descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        struct stat info;
+        fstat(descriptor, &info);
+        length = size_t(info.st_size);
+        if (length > 0) {
+            void* view = mmap(nullptr, length, privateWrites ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (view == MAP_FAILED) {
+                close();
+                throw std::runtime_error("Cannot map " + path);
+            }
+            bytes = static_cast<char*>(view);
+            madvise(view, length, MADV_SEQUENTIAL);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            bytes = other.bytes;
+            length = other.length;
+#if defined(_WIN32)
+            file = other.file;
+            mapping = other.mapping;
+            other.file = INVALID_HANDLE_VALUE;
+            other.mapping = nullptr;
+#else
+            descriptor = other.descriptor;
+            other.descriptor = -1;
+#endif
+            other.bytes = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    // First byte of the file, or null for an empty file.
+    const char* data() const {
+        return bytes;
+    }
+
+    // Writable view of a mapping opened with privateWrites.
+    char* privateData() {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+    void close() {
+#if defined(_WIN32)
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+        mapping = nullptr;
+#else
+        if (bytes) munmap(bytes, length);
+        if (descriptor >= 0) ::close(descriptor);
+        descriptor = -1;
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    char* bytes = nullptr;
+    size_t length = 0;
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int descriptor = -1;
+#endif
+};
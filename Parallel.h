@@ -0,0 +1,46 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+
+    // Returns the number of hardware threads available to the engines.
+    // Falls back to a single worker when the platform cannot report it,
+    // so callers never have to special-case a zero result.
+    inline unsigned workerCount() {
+        const unsigned count = std::thread::hardware_concurrency();
+        return count == 0 ? 1 : count;
+    }
+
+    // Splits [begin, end) into one contiguous chunk per worker and calls fn(chunkBegin, chunkEnd)
+    // on each of them concurrently. The calling thread processes the first chunk itself and
+    // waits for the others, so the call behaves like a plain loop from the outside.
+    // minChunk keeps tiny ranges from being spread over more threads than they are worth.
+    template <typename Fn>
+    void forRange(size_t begin, size_t end, Fn&& fn, size_t minChunk = 1) {
+        if (end <= begin) {
+            return;
+        }
+        const size_t count = end - begin;
+        const size_t threads = std::min<size_t>(workerCount(), (count + minChunk - 1) / minChunk);
+        if (threads <= 1) {
+            fn(begin, end);
+            return;
+        }
+
+        const size_t chunk = (count + threads - 1) / threads;
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (size_t first = begin + chunk; first < end; first += chunk) {
+            const size_t last = std::min(end, first + chunk);
+            pool.emplace_back([&fn, first, last]() { fn(first, last); });
+        }
+        fn(begin, std::min(end, begin + chunk));
+        for (auto& worker : pool) {
+            worker.join();
+        }
+    }
+
+} // namespace Parallel
@@ -0,0 +1,466 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DenseEngine.h"
+#include "Parallel.h"
+#include "TiledEngine.h"
+
+// Writers for RLE and Golly's macrocell format that read the engines' bit rows directly.
+// Live cells are never listed one by one: runs are found a word at a time with bit scans,
+// RLE is encoded in row bands on every core, and the bands are streamed out in order
+// through one large buffer.
+namespace PatternExport {
+
+    using TiledEngine::Tile;
+    using TiledEngine::TileKey;
+    using TiledEngine::tileSize;
+
+    // Output file with a large write buffer, so encoders can emit text a few bytes at a time.
+    class BufferedWriter {
+    public:
+        explicit BufferedWriter(const std::string& path, size_t bufferSize = size_t(1) << 20)
+            : file(std::fopen(path.c_str(), "wb")), path(path) {
+            if (!file) {
+                throw std::runtime_error("Cannot create " + path);
+            }
+            buffer.reserve(bufferSize);
+        }
+
+        BufferedWriter(const BufferedWriter&) = delete;
+        BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+        ~BufferedWriter() {
+            if (file) {
+                std::fwrite(buffer.data(), 1, buffer.size(), file);
+                std::fclose(file);
+            }
+        }
+
+        void write(const char* data, size_t size) {
+            if (buffer.size() + size > buffer.capacity()) {
+                flush();
+                if (size > buffer.capacity()) {
+                    put(data, size);
+                    return;
+                }
+            }
+            buffer.insert(buffer.end(), data, data + size);
+        }
+
+        void write(const std::string& text) {
+            write(text.data(), text.size());
+        }
+
+        void put(char c) {
+            if (buffer.size() == buffer.capacity()) {
+                flush();
+            }
+            buffer.push_back(c);
+        }
+
+        void flush() {
+            put(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+
+        // Flushes and closes the file, reporting write errors the destructor would swallow.
+        void close() {
+            flush();
+            const bool failed = std::fclose(file) != 0;
+            file = nullptr;
+            if (failed) {
+                throw std::runtime_error("Cannot write " + path);
+            }
+        }
+
+    private:
+        void put(const char* data, size_t size) {
+            if (size && std::fwrite(data, 1, size, file) != size) {
+                throw std::runtime_error("Cannot write " + path);
+            }
+        }
+
+        std::FILE* file;
+        std::string path;
+        std::vector<char> buffer;
+    };
+
+    // In-memory counterpart of BufferedWriter, for text headed to the clipboard.
+    struct StringWriter {
+        std::string text;
+
+        void write(const char* data, size_t size) {
+            text.append(data, size);
+        }
+
+        void write(const std::string& more) {
+            text += more;
+        }
+
+        void put(char c) {
+            text += c;
+        }
+    };
+
+    // Appends an RLE token: the run length (omitted when 1) followed by the tag.
+    inline void appendRun(std::string& out, long long count, char tag) {
+        if (count > 1) {
+            char digits[24];
+            char* p = digits + sizeof(digits);
+            for (; count; count /= 10) {
+                *--p = char('0' + count % 10);
+            }
+            out.append(p, digits + sizeof(digits));
+        }
+        out += tag;
+    }
+
+    // Turns the words of one row into 'b' and 'o' runs. Words must arrive in increasing x;
+    // gaps between them are dead and trailing dead cells are never written.
+    class RowEncoder {
+    public:
+        RowEncoder(std::string& out, long long originX) : out(out), cursor(originX) {}
+
+        // Adds a word whose bit i is cell x + i.
+        void add(long long x, uint64_t bits) {
+            while (bits) {
+                const int start = LifeKernel::countTrailingZeros(bits);
+                const uint64_t rest = ~(bits >> start);
+                const int length = rest ? LifeKernel::countTrailingZeros(rest) : tileSize - start;
+                const long long cellX = x + start;
+                if (!(alive && cellX == cursor)) {
+                    flush();
+                    if (cellX > cursor) {
+                        appendRun(out, cellX - cursor, 'b');
+                    }
+                }
+                alive += length;
+                cursor = cellX + length;
+                bits = start + length == tileSize ? 0 : bits & (~uint64_t(0) << (start + length));
+            }
+        }
+
+        // Writes the pending live run; returns whether the row had any live cell.
+        bool finish() {
+            flush();
+            return any;
+        }
+
+    private:
+        void flush() {
+            if (alive) {
+                appendRun(out, alive, 'o');
+                alive = 0;
+                any = true;
+            }
+        }
+
+        std::string& out;
+        long long cursor;
+        long long alive = 0;
+        bool any = false;
+    };
+
+    // RLE of a run of rows, without the '$' before its first row or after its last one.
+    // The text is empty when none of the rows had a live cell.
+    struct Band {
+        std::string text;
+        long long firstRow = 0;
+        long long lastRow = 0;
+    };
+
+    // Encodes rows [first, last). rowWords(y, emit) calls emit(x, bits) for the words of row y
+    // in increasing x.
+    template <typename RowWords>
+    Band encodeBand(long long first, long long last, long long originX, const RowWords& rowWords) {
+        Band band;
+        std::string row;
+        for (long long y = first; y < last; ++y) {
+            row.clear();
+            RowEncoder encoder(row, originX);
+            rowWords(y, [&](long long x, uint64_t bits) { encoder.add(x, bits); });
+            if (!encoder.finish()) {
+                continue;
+            }
+            if (band.text.empty()) {
+                band.firstRow = y;
+            }
+            else {
+                appendRun(band.text, y - band.lastRow, '$');
+            }
+            band.text += row;
+            band.lastRow = y;
+        }
+        return band;
+    }
+
+    // Copies RLE tokens to the output, breaking lines before they pass 70 characters.
+    template <typename Out>
+    class LineWrapper {
+    public:
+        explicit LineWrapper(Out& out) : out(out) {}
+
+        void write(const std::string& tokens) {
+            const char* text = tokens.data();
+            size_t line = 0;
+            size_t begin = 0;
+            while (begin < tokens.size()) {
+                size_t end = begin;
+                while (text[end] >= '0' && text[end] <= '9') {
+                    ++end;
+                }
+                ++end;
+                if (column + (end - begin) > 70) {
+                    out.write(text + line, begin - line);
+                    out.put('\n');
+                    line = begin;
+                    column = 0;
+                }
+                column += end - begin;
+                begin = end;
+            }
+            out.write(text + line, tokens.size() - line);
+        }
+
+    private:
+        Out& out;
+        size_t column = 0;
+    };
+
+    // Writes the RLE of the rectangle at (originX, originY). Bands of 64 rows are encoded in
+    // parallel, a few per worker at a time, and written in order as soon as they are done, so
+    // memory stays bounded by a handful of bands whatever the size of the pattern.
+    template <typename Out, typename RowWords>
+    void writeRle(Out& out, long long originX, long long originY, long long width, long long height,
+                  const std::string& rule, const RowWords& rowWords) {
+        out.write("x = " + std::to_string(width) + ", y = " + std::to_string(height) + ", rule = " + rule + "\n");
+        LineWrapper<Out> wrapper(out);
+        const long long bands = (height + tileSize - 1) / tileSize;
+        const long long batch = std::max<long long>(1, Parallel::workerCount() * 4);
+        long long lastRow = originY;
+        std::vector<Band> encoded;
+        for (long long firstBand = 0; firstBand < bands; firstBand += batch) {
+            encoded.assign(size_t(std::min(batch, bands - firstBand)), Band());
+            Parallel::forRange(0, encoded.size(), [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    const long long top = originY + (firstBand + (long long)i) * tileSize;
+                    encoded[i] = encodeBand(top, std::min(top + tileSize, originY + height), originX, rowWords);
+                }
+            });
+            for (const Band& band : encoded) {
+                if (band.text.empty()) {
+                    continue;
+                }
+                if (band.firstRow > lastRow) {
+                    std::string separator;
+                    appendRun(separator, band.firstRow - lastRow, '$');
+                    wrapper.write(separator);
+                }
+                wrapper.write(band.text);
+                lastRow = band.lastRow;
+            }
+        }
+        wrapper.write("!");
+        out.put('\n');
+    }
+
+    // RLE of the live cells of a tiled universe, cropped to their bounding box.
+    inline void writeRle(BufferedWriter& out, const TiledEngine::Universe& universe) {
+        // Tiles grouped by tile row and sorted by column.
+        std::map<int, std::vector<std::pair<int, const Tile*>>> byRow;
+        UniverseHash::BoundingBox box;
+        for (const auto& entry : universe.getTiles()) {
+            byRow[entry.first.y].push_back({ entry.first.x, entry.second.get() });
+            box.merge(entry.second->boundingBox(entry.first.x * tileSize, entry.first.y * tileSize));
+        }
+        for (auto& row : byRow) {
+            std::sort(row.second.begin(), row.second.end(),
+                      [](const auto& a, const auto& b) { return a.first < b.first; });
+        }
+        if (box.isEmpty()) {
+            box = UniverseHash::BoundingBox{ 0, 0, -1, -1 };
+        }
+        writeRle(out, box.minX, box.minY, (long long)box.maxX - box.minX + 1, (long long)box.maxY - box.minY + 1,
+                 universe.getRule().toString(), [&](long long y, const auto& emit) {
+            const auto it = byRow.find(TiledEngine::tileCoord(int(y)));
+            if (it == byRow.end()) {
+                return;
+            }
+            const int r = TiledEngine::inTile(int(y));
+            for (const auto& tile : it->second) {
+                emit((long long)tile.first * tileSize, tile.second->rows[r]);
+            }
+        });
+    }
+
+    // RLE of a whole dense board, read straight from its padded rows.
+    inline void writeRle(BufferedWriter& out, const DenseEngine::Board& board) {
+        const auto& mask = board.getInteriorMask();
+        writeRle(out, 0, 0, board.getWidth(), board.getHeight(), board.getRule().toString(),
+                 [&](long long y, const auto& emit) {
+            const uint64_t* row = board.paddedRow(int(y) + 1);
+            for (int k = 1; k <= board.getWords(); ++k) {
+                // Padded bit p holds cell p - 1.
+                emit((long long)(k - 1) * 64 - 1, row[k] & mask[k]);
+            }
+        });
+    }
+
+    // Writes a tiled universe as a macrocell quadtree. Every tile is split into 8x8 leaves
+    // and built up to a level-6 node, and tiles are then paired up level by level until one
+    // root, centred on the origin, covers the whole universe. Identical nodes are written
+    // once, so repetitive patterns stay small; each node is written as soon as it is made,
+    // after its children, which is the order the format requires.
+    inline void writeMacrocell(BufferedWriter& out, const TiledEngine::Universe& universe) {
+        out.write("[M2] (GameOfLife)\n#R " + universe.getRule().toString() + "\n");
+        if (universe.getTiles().empty()) {
+            return;
+        }
+
+        struct NodeKey {
+            int level;
+            std::array<uint32_t, 4> children;
+
+            bool operator==(const NodeKey& other) const {
+                return level == other.level && children == other.children;
+            }
+        };
+        struct NodeKeyHash {
+            size_t operator()(const NodeKey& key) const {
+                uint64_t h = uint64_t(key.level);
+                for (uint32_t child : key.children) {
+                    h = (h ^ child) * 0x9E3779B97F4A7C15ull;
+                }
+                return size_t(h ^ (h >> 32));
+            }
+        };
+        std::unordered_map<uint64_t, uint32_t> leaves;
+        std::unordered_map<NodeKey, uint32_t, NodeKeyHash> nodes;
+        uint32_t count = 0;
+        leaves.reserve(universe.getTiles().size() * 16);
+        nodes.reserve(universe.getTiles().size() * 8);
+
+        auto leafNode = [&](uint64_t bits) -> uint32_t {
+            if (!bits) {
+                return 0;
+            }
+            const auto inserted = leaves.emplace(bits, count + 1);
+            if (!inserted.second) {
+                return inserted.first->second;
+            }
+            // Text of every possible leaf row, trailing dead cells dropped.
+            static const std::array<std::string, 256> rowText = []() {
+                std::array<std::string, 256> text;
+                for (unsigned row = 0; row < 256; ++row) {
+                    for (int x = 0; x < 8 && (row >> x); ++x) {
+                        text[row] += ((row >> x) & 1) ? '*' : '.';
+                    }
+                    text[row] += '$';
+                }
+                return text;
+            }();
+            char line[8 * 9 + 1];
+            size_t length = 0;
+            int lastRow = 7;
+            while (((bits >> (lastRow * 8)) & 0xFF) == 0) {
+                --lastRow;
+            }
+            for (int r = 0; r <= lastRow; ++r) {
+                const std::string& text = rowText[(bits >> (r * 8)) & 0xFF];
+                std::copy(text.begin(), text.end(), line + length);
+                length += text.size();
+            }
+            line[length++] = '\n';
+            out.write(line, length);
+            return ++count;
+        };
+        auto innerNode = [&](int level, const std::array<uint32_t, 4>& children) -> uint32_t {
+            if (children == std::array<uint32_t, 4>{ 0, 0, 0, 0 }) {
+                return 0;
+            }
+            const NodeKey key{ level, children };
+            const auto inserted = nodes.emplace(key, count + 1);
+            if (!inserted.second) {
+                return inserted.first->second;
+            }
+            out.write(std::to_string(level) + " " + std::to_string(children[0]) + " " + std::to_string(children[1]) + " "
+                      + std::to_string(children[2]) + " " + std::to_string(children[3]) + "\n");
+            return ++count;
+        };
+        // Node of the 2^level square at (x, y) inside a tile, for levels 3 to 6.
+        auto tileNode = [&](const Tile& tile, int level, int x, int y, const auto& self) -> uint32_t {
+            if (level == 3) {
+                uint64_t bits = 0;
+                for (int r = 0; r < 8; ++r) {
+                    bits |= ((tile.rows[y + r] >> x) & 0xFF) << (r * 8);
+                }
+                return leafNode(bits);
+            }
+            const int half = 1 << (level - 1);
+            return innerNode(level, { self(tile, level - 1, x, y, self), self(tile, level - 1, x + half, y, self),
+                                      self(tile, level - 1, x, y + half, self), self(tile, level - 1, x + half, y + half, self) });
+        };
+
+        // Smallest root level, at least 7 so that the root's corner is tile-aligned.
+        int minTile = 0, maxTile = 0;
+        for (const auto& entry : universe.getTiles()) {
+            minTile = std::min({ minTile, entry.first.x, entry.first.y });
+            maxTile = std::max({ maxTile, entry.first.x, entry.first.y });
+        }
+        int rootLevel = 7;
+        while ((1ll << (rootLevel - 7)) < std::max<long long>(-(long long)minTile, (long long)maxTile + 1)) {
+            ++rootLevel;
+        }
+        const int shift = 1 << (rootLevel - 7);
+
+        // Level-6 nodes keyed by tile position relative to the root's corner, in row order.
+        std::map<TileKey, uint32_t> level;
+        std::vector<TileKey> keys;
+        for (const auto& entry : universe.getTiles()) {
+            keys.push_back(entry.first);
+        }
+        std::sort(keys.begin(), keys.end());
+        for (const TileKey& key : keys) {
+            if (const uint32_t node = tileNode(*universe.findTile(key), 6, 0, 0, tileNode)) {
+                level[{ key.x + shift, key.y + shift }] = node;
+            }
+        }
+        for (int nodeLevel = 7; nodeLevel <= rootLevel; ++nodeLevel) {
+            std::map<TileKey, std::array<uint32_t, 4>> parents;
+            for (const auto& entry : level) {
+                parents[{ entry.first.x >> 1, entry.first.y >> 1 }][size_t((entry.first.x & 1) + 2 * (entry.first.y & 1))] = entry.second;
+            }
+            level.clear();
+            for (const auto& entry : parents) {
+                level[entry.first] = innerNode(nodeLevel, entry.second);
+            }
+        }
+    }
+
+    inline void saveRle(const std::string& path, const TiledEngine::Universe& universe) {
+        BufferedWriter out(path);
+        writeRle(out, universe);
+        out.close();
+    }
+
+    inline void saveRle(const std::string& path, const DenseEngine::Board& board) {
+        BufferedWriter out(path);
+        writeRle(out, board);
+        out.close();
+    }
+
+    inline void saveMacrocell(const std::string& path, const TiledEngine::Universe& universe) {
+        BufferedWriter out(path);
+        writeMacrocell(out, universe);
+        out.close();
+    }
+
+} // namespace PatternExport
@@ -0,0 +1,511 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "TiledEngine.h"
+
+// Readers for the common Life pattern formats: RLE, Life 1.05, Life 1.06, plaintext .cells
+// and Golly's macrocell .mc. Files are memory-mapped and decoded straight into 64x64 tiles,
+// runs of live cells being OR-ed into tile rows a word at a time, so no list of cells is
+// ever built. Large RLE bodies are cut at row boundaries and decoded on every core.
+namespace PatternImport {
+
+    using TiledEngine::Tile;
+    using TiledEngine::TileKey;
+    using TiledEngine::TileKeyHash;
+    using TiledEngine::tileSize;
+
+    enum class Format {
+        Rle,
+        Life105,
+        Life106,
+        Plaintext,
+        Macrocell,
+        Unknown
+    };
+
+    // What a file said about itself besides its cells. The rule is empty when the file
+    // does not name one; width and height are only known for RLE.
+    struct Info {
+        Format format = Format::Unknown;
+        std::string rule;
+        int width = 0;
+        int height = 0;
+    };
+
+    // Collects cells into tiles. The tile written last is cached, since consecutive writes
+    // almost always land in the same tile; pointers into the map survive rehashing.
+    class TileWriter {
+    public:
+        // Sets the `bits` of a word whose bit 0 is cell (x, y), splitting it over two tiles
+        // when x is not tile-aligned.
+        void orBits(long long x, long long y, uint64_t bits) {
+            if (!bits) {
+                return;
+            }
+            const int cellX = checked(x), cellY = checked(y);
+            const int offset = TiledEngine::inTile(cellX);
+            rowOf(cellX, cellY) |= bits << offset;
+            if (offset && (bits >> (tileSize - offset))) {
+                rowOf(checked(x + tileSize - offset), cellY) |= bits >> (tileSize - offset);
+            }
+        }
+
+        // Sets cells [x, x + length) of row y.
+        void setRun(long long x, long long y, long long length) {
+            while (length > 0) {
+                const int offset = TiledEngine::inTile(checked(x));
+                const long long count = std::min<long long>(length, tileSize - offset);
+                const uint64_t bits = count == tileSize ? ~uint64_t(0) : ((uint64_t(1) << count) - 1);
+                rowOf(checked(x), checked(y)) |= bits << offset;
+                x += count;
+                length -= count;
+            }
+        }
+
+        void setCell(long long x, long long y) {
+            orBits(x, y, 1);
+        }
+
+        std::unordered_map<TileKey, Tile, TileKeyHash>& getTiles() {
+            return tiles;
+        }
+
+        // Moves every collected tile into `universe`, keeping what it already holds.
+        void commit(TiledEngine::Universe& universe) {
+            for (const auto& entry : tiles) {
+                universe.mergeTile(entry.first, entry.second);
+            }
+            tiles.clear();
+            last = nullptr;
+        }
+
+    private:
+        static int checked(long long c) {
+            if (c < -(1ll << 30) || c >= (1ll << 30)) {
+                throw std::runtime_error("Pattern coordinate out of range");
+            }
+            return int(c);
+        }
+
+        uint64_t& rowOf(int x, int y) {
+            const TileKey key{ TiledEngine::tileCoord(x), TiledEngine::tileCoord(y) };
+            if (!last || key != lastKey) {
+                last = &tiles[key];
+                lastKey = key;
+            }
+            return last->rows[TiledEngine::inTile(y)];
+        }
+
+        std::unordered_map<TileKey, Tile, TileKeyHash> tiles;
+        TileKey lastKey{ 0, 0 };
+        Tile* last = nullptr;
+    };
+
+    // Cursor over a text buffer, line by line.
+    struct Lines {
+        const char* position;
+        const char* end;
+
+        bool next(const char*& lineBegin, const char*& lineEnd) {
+            if (position >= end) {
+                return false;
+            }
+            lineBegin = position;
+            const char* newline = static_cast<const char*>(std::memchr(position, '\n', size_t(end - position)));
+            lineEnd = newline ? newline : end;
+            position = newline ? newline + 1 : end;
+            while (lineEnd > lineBegin && (lineEnd[-1] == '\r' || lineEnd[-1] == ' ' || lineEnd[-1] == '\t')) {
+                --lineEnd;
+            }
+            return true;
+        }
+    };
+
+    inline bool startsWith(const char* begin, const char* end, const char* prefix) {
+        const size_t length = std::strlen(prefix);
+        return size_t(end - begin) >= length && std::memcmp(begin, prefix, length) == 0;
+    }
+
+    inline std::string trimmed(const char* begin, const char* end) {
+        while (begin < end && (*begin == ' ' || *begin == '\t')) ++begin;
+        return std::string(begin, end);
+    }
+
+    // Guesses the format from the first line, falling back to the file extension.
+    inline Format detect(const char* data, size_t size, const std::string& path = "") {
+        Lines lines{ data, data + size };
+        const char* begin;
+        const char* end;
+        while (lines.next(begin, end)) {
+            if (startsWith(begin, end, "#Life 1.05")) return Format::Life105;
+            if (startsWith(begin, end, "#Life 1.06")) return Format::Life106;
+            if (startsWith(begin, end, "[M2]")) return Format::Macrocell;
+            if (begin == end || *begin == '#') continue;
+            if (*begin == '!') return Format::Plaintext;
+            if (*begin == 'x' && std::find(begin, end, '=') != end) return Format::Rle;
+            break;
+        }
+        const size_t dot = path.rfind('.');
+        std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return char(std::tolower((unsigned char)c)); });
+        if (extension == "rle") return Format::Rle;
+        if (extension == "cells") return Format::Plaintext;
+        if (extension == "mc") return Format::Macrocell;
+        if (extension == "lif" || extension == "life") return Format::Life106;
+        return Format::Unknown;
+    }
+
+    // Decodes RLE body text from `begin`, which must sit at the start of a row, with that row
+    // being row y. Stops at '!' or `end`. Returns the number of rows the text advanced.
+    inline long long decodeRleRows(const char* begin, const char* end, long long originX, long long y, TileWriter* writer) {
+        const long long firstRow = y;
+        long long x = 0;
+        long long count = 0;
+        bool prefixed = false;
+        for (const char* p = begin; p < end; ++p) {
+            const char c = *p;
+            if (c >= '0' && c <= '9') {
+                count = count * 10 + (c - '0');
+                continue;
+            }
+            const long long run = count ? count : 1;
+            if (c == '!') {
+                break;
+            }
+            if (c == '$') {
+                y += run;
+                x = 0;
+            }
+            else if (c == 'b' || c == '.') {
+                x += run;
+            }
+            else if (c >= 'p' && c <= 'y') {
+                // Multi-state prefix; the letter after it carries the run.
+                prefixed = true;
+                continue;
+            }
+            else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'X')) {
+                if (writer) {
+                    writer->setRun(originX + x, y, run);
+                }
+                x += run;
+            }
+            else if (c != '\n' && c != '\r' && c != ' ' && c != '\t') {
+                throw std::runtime_error(std::string("Unexpected character in RLE: ") + c);
+            }
+            else if (count || prefixed) {
+                continue;
+            }
+            count = 0;
+            prefixed = false;
+        }
+        return y - firstRow;
+    }
+
+    // Reads an RLE file. The body is cut into chunks that start just after a '$', so every
+    // chunk starts at column 0 of some row. A first parallel pass counts the rows each chunk
+    // advances, a prefix sum turns that into each chunk's first row, and a second parallel
+    // pass decodes every chunk into its own tiles, which are then merged.
+    inline Info readRle(const char* data, size_t size, TiledEngine::Universe& universe, int originX, int originY) {
+        Info info;
+        info.format = Format::Rle;
+        Lines lines{ data, data + size };
+        const char* begin;
+        const char* end;
+        const char* body = data + size;
+        while (lines.next(begin, end)) {
+            if (begin == end || *begin == '#') {
+                continue;
+            }
+            if (*begin == 'x') {
+                const std::string header(begin, end);
+                for (size_t start = 0; start < header.size();) {
+                    size_t comma = header.find(',', start);
+                    if (comma == std::string::npos) comma = header.size();
+                    const std::string field = header.substr(start, comma - start);
+                    const size_t equals = field.find('=');
+                    if (equals != std::string::npos) {
+                        std::string key = field.substr(0, equals);
+                        key.erase(std::remove(key.begin(), key.end(), ' '), key.end());
+                        const std::string value = trimmed(field.data() + equals + 1, field.data() + field.size());
+                        if (key == "x") info.width = std::atoi(value.c_str());
+                        else if (key == "y") info.height = std::atoi(value.c_str());
+                        else if (key == "rule") info.rule = value;
+                    }
+                    start = comma + 1;
+                }
+                body = lines.position;
+            }
+            else {
+                body = begin;
+            }
+            break;
+        }
+        const char* bodyEnd = data + size;
+        if (const void* bang = std::memchr(body, '!', size_t(bodyEnd - body))) {
+            bodyEnd = static_cast<const char*>(bang);
+        }
+
+        const size_t chunkBytes = size_t(1) << 20;
+        const size_t wanted = std::max<size_t>(1, std::min<size_t>(size_t(bodyEnd - body) / chunkBytes, Parallel::workerCount() * 4));
+        std::vector<const char*> starts{ body };
+        for (size_t i = 1; i < wanted; ++i) {
+            const char* candidate = std::max(starts.back(), body + (bodyEnd - body) * ptrdiff_t(i) / ptrdiff_t(wanted));
+            const void* dollar = std::memchr(candidate, '$', size_t(bodyEnd - candidate));
+            if (!dollar) {
+                break;
+            }
+            starts.push_back(static_cast<const char*>(dollar) + 1);
+        }
+        starts.push_back(bodyEnd);
+        const size_t chunks = starts.size() - 1;
+
+        std::vector<long long> firstRows(chunks + 1, 0);
+        Parallel::forRange(0, chunks, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                firstRows[i + 1] = decodeRleRows(starts[i], starts[i + 1], 0, 0, nullptr);
+            }
+        });
+        for (size_t i = 0; i < chunks; ++i) {
+            firstRows[i + 1] += firstRows[i];
+        }
+
+        std::vector<TileWriter> writers(chunks);
+        Parallel::forRange(0, chunks, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                decodeRleRows(starts[i], starts[i + 1], originX, originY + firstRows[i], &writers[i]);
+            }
+        });
+        for (TileWriter& writer : writers) {
+            writer.commit(universe);
+        }
+        return info;
+    }
+
+    // Reads Life 1.05: "#P x y" starts a block of '.' and '*' rows at (x, y), "#N" selects
+    // Conway's rule and "#R s/b" another one.
+    inline Info readLife105(const char* data, size_t size, TiledEngine::Universe& universe, int originX, int originY) {
+        Info info;
+        info.format = Format::Life105;
+        TileWriter writer;
+        Lines lines{ data, data + size };
+        const char* begin;
+        const char* end;
+        long long blockX = 0, y = 0;
+        while (lines.next(begin, end)) {
+            if (startsWith(begin, end, "#P")) {
+                const std::string position(begin + 2, end);
+                char* next = nullptr;
+                blockX = std::strtoll(position.c_str(), &next, 10);
+                y = std::strtoll(next, nullptr, 10);
+            }
+            else if (startsWith(begin, end, "#N")) {
+                info.rule = "B3/S23";
+            }
+            else if (startsWith(begin, end, "#R")) {
+                info.rule = trimmed(begin + 2, end);
+            }
+            else if (begin < end && *begin != '#') {
+                for (const char* p = begin; p < end; ++p) {
+                    if (*p == '*') {
+                        writer.setCell(originX + blockX + (p - begin), originY + y);
+                    }
+                }
+                ++y;
+            }
+        }
+        writer.commit(universe);
+        return info;
+    }
+
+    // Reads Life 1.06: one "x y" pair per line. Lines are independent, so the file is cut
+    // at newlines and read on every core.
+    inline Info readLife106(const char* data, size_t size, TiledEngine::Universe& universe, int originX, int originY) {
+        Info info;
+        info.format = Format::Life106;
+        const char* end = data + size;
+        const size_t wanted = std::max<size_t>(1, std::min<size_t>(size / (size_t(1) << 20), Parallel::workerCount() * 4));
+        std::vector<const char*> starts{ data };
+        for (size_t i = 1; i < wanted; ++i) {
+            const char* candidate = std::max(starts.back(), data + ptrdiff_t(size) * ptrdiff_t(i) / ptrdiff_t(wanted));
+            const void* newline = std::memchr(candidate, '\n', size_t(end - candidate));
+            if (!newline) {
+                break;
+            }
+            starts.push_back(static_cast<const char*>(newline) + 1);
+        }
+        starts.push_back(end);
+
+        std::vector<TileWriter> writers(starts.size() - 1);
+        Parallel::forRange(0, writers.size(), [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                Lines lines{ starts[i], starts[i + 1] };
+                const char* begin;
+                const char* lineEnd;
+                while (lines.next(begin, lineEnd)) {
+                    if (begin == lineEnd || *begin == '#') {
+                        continue;
+                    }
+                    const std::string line(begin, lineEnd);
+                    char* next = nullptr;
+                    const long long x = std::strtoll(line.c_str(), &next, 10);
+                    const long long y = std::strtoll(next, nullptr, 10);
+                    writers[i].setCell(originX + x, originY + y);
+                }
+            }
+        });
+        for (TileWriter& writer : writers) {
+            writer.commit(universe);
+        }
+        return info;
+    }
+
+    // Reads plaintext: '!' lines are comments, every other line is a row of '.' and 'O'.
+    inline Info readPlaintext(const char* data, size_t size, TiledEngine::Universe& universe, int originX, int originY) {
+        Info info;
+        info.format = Format::Plaintext;
+        TileWriter writer;
+        Lines lines{ data, data + size };
+        const char* begin;
+        const char* end;
+        long long y = 0;
+        while (lines.next(begin, end)) {
+            if (begin < end && *begin == '!') {
+                continue;
+            }
+            for (const char* p = begin; p < end; ++p) {
+                if (*p == 'O' || *p == '*') {
+                    writer.setCell(originX + (p - begin), originY + y);
+                }
+            }
+            ++y;
+        }
+        writer.commit(universe);
+        return info;
+    }
+
+    // Reads Golly's macrocell format, a serialised quadtree. Leaves are 8x8 nodes written as
+    // rows of '.' and '*' separated by '$'; every other line is "level nw ne sw se" with
+    // children numbered from 1 in order of appearance and 0 for an empty child. The last
+    // node is the root, centred on the origin as Golly places it.
+    inline Info readMacrocell(const char* data, size_t size, TiledEngine::Universe& universe, int originX, int originY) {
+        struct Node {
+            int level = 3;
+            uint32_t children[4] = { 0, 0, 0, 0 };
+            uint64_t leaf = 0; // Byte r holds row r, bit x of it column x.
+        };
+        Info info;
+        info.format = Format::Macrocell;
+        std::vector<Node> nodes(1);
+        Lines lines{ data, data + size };
+        const char* begin;
+        const char* end;
+        while (lines.next(begin, end)) {
+            if (begin == end || *begin == '[') {
+                continue;
+            }
+            if (*begin == '#') {
+                if (startsWith(begin, end, "#R")) {
+                    info.rule = trimmed(begin + 2, end);
+                }
+                continue;
+            }
+            Node node;
+            if (*begin == '.' || *begin == '*' || *begin == '$') {
+                int x = 0, y = 0;
+                for (const char* p = begin; p < end && y < 8; ++p) {
+                    if (*p == '$') {
+                        ++y;
+                        x = 0;
+                    }
+                    else {
+                        if (*p == '*' && x < 8) {
+                            node.leaf |= uint64_t(1) << (y * 8 + x);
+                        }
+                        ++x;
+                    }
+                }
+            }
+            else {
+                const std::string line(begin, end);
+                char* next = nullptr;
+                node.level = int(std::strtol(line.c_str(), &next, 10));
+                for (uint32_t& child : node.children) {
+                    child = uint32_t(std::strtoul(next, &next, 10));
+                }
+                if (node.level <= 3 || node.level > 32) {
+                    throw std::runtime_error("Unsupported macrocell node level " + std::to_string(node.level));
+                }
+                for (uint32_t child : node.children) {
+                    if (child >= nodes.size() || (child && nodes[child].level != node.level - 1)) {
+                        throw std::runtime_error("Malformed macrocell node");
+                    }
+                }
+            }
+            nodes.push_back(node);
+        }
+        if (nodes.size() == 1) {
+            return info;
+        }
+
+        TileWriter writer;
+        std::vector<std::pair<uint32_t, std::pair<long long, long long>>> stack;
+        const long long half = 1ll << (nodes.back().level - 1);
+        stack.push_back({ uint32_t(nodes.size() - 1), { originX - half, originY - half } });
+        while (!stack.empty()) {
+            const uint32_t index = stack.back().first;
+            const long long x = stack.back().second.first;
+            const long long y = stack.back().second.second;
+            stack.pop_back();
+            const Node& node = nodes[index];
+            if (node.level == 3) {
+                for (int r = 0; r < 8; ++r) {
+                    writer.orBits(x, y + r, (node.leaf >> (r * 8)) & 0xFF);
+                }
+                continue;
+            }
+            const long long quarter = 1ll << (node.level - 1);
+            for (int i = 0; i < 4; ++i) {
+                if (node.children[i]) {
+                    stack.push_back({ node.children[i], { x + (i & 1) * quarter, y + (i >> 1) * quarter } });
+                }
+            }
+        }
+        writer.commit(universe);
+        return info;
+    }
+
+    // Adds the pattern in `data` to `universe`, offset by (originX, originY).
+    // Throws std::runtime_error when the text cannot be read as `format`.
+    inline Info parse(const char* data, size_t size, Format format, TiledEngine::Universe& universe, int originX = 0, int originY = 0) {
+        if (size == 0 && format != Format::Unknown) {
+            Info info;
+            info.format = format;
+            return info;
+        }
+        switch (format) {
+        case Format::Rle: return readRle(data, size, universe, originX, originY);
+        case Format::Life105: return readLife105(data, size, universe, originX, originY);
+        case Format::Life106: return readLife106(data, size, universe, originX, originY);
+        case Format::Plaintext: return readPlaintext(data, size, universe, originX, originY);
+        case Format::Macrocell: return readMacrocell(data, size, universe, originX, originY);
+        default: throw std::runtime_error("Unknown pattern format");
+        }
+    }
+
+    // Memory-maps a pattern file and adds it to `universe`.
+    inline Info load(const std::string& path, TiledEngine::Universe& universe, int originX = 0, int originY = 0) {
+        const MappedFile file(path);
+        return parse(file.data(), file.size(), detect(file.data(), file.size(), path), universe, originX, originY);
+    }
+
+} // namespace PatternImport
@@ -0,0 +1,329 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+#include "PatternExport.h"
+#include "PatternImport.h"
+#include "TiledEngine.h"
+
+// A collection of named patterns that can grow to thousands of files without slowing down
+// startup. An index built ahead of time lists every pattern's name, rule, size and
+// population, so opening a library only maps the index and reads its header. A pattern's
+// cells are read the first time it is asked for and kept in a small LRU cache.
+//
+// The index lives either next to the pattern files of a directory (index.golidx, pointing at
+// the files by relative path) or at the front of a single packed archive (.golpack) that
+// also holds every pattern file byte for byte, which the readers then parse in place.
+//
+// Layout (little-endian): a 64-byte Header, entryCount Entry records sorted by name, the
+// string table for names, rules and paths, then in an archive the pattern files themselves.
+namespace PatternLibrary {
+
+    constexpr char magic[8] = { 'G', 'O', 'L', 'P', 'A', 'T', 'T', 'S' };
+    constexpr uint32_t version = 1;
+    constexpr uint32_t byteOrderMark = 0x01020304;
+    constexpr const char* indexName = "index.golidx";
+    constexpr size_t defaultCacheSize = 32;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t entryCount;
+        uint64_t entriesOffset;
+        uint64_t stringsOffset;
+        uint64_t stringsSize;
+        uint32_t packed;
+        uint8_t reserved[12];
+    };
+
+    // One pattern. Offsets into the string table are relative to its start; the data range is
+    // an absolute file range in an archive and the pattern's relative path in a directory.
+    struct Entry {
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t ruleOffset;
+        uint32_t ruleLength;
+        uint64_t dataOffset;
+        uint64_t dataSize;
+        int32_t width;
+        int32_t height;
+        uint64_t population;
+        uint32_t format;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(Header) == 64, "Library header must be 64 bytes");
+    static_assert(sizeof(Entry) == 56, "Library entries must be 56 bytes");
+
+    // A loaded pattern, positioned as its file places it. Shared so that a pattern evicted
+    // from the cache stays valid for whoever is still placing it.
+    using Pattern = std::shared_ptr<const TiledEngine::Universe>;
+
+    struct BuildResult {
+        size_t indexed = 0;
+        size_t skipped = 0;
+    };
+
+    // Indexes every pattern file under `directory` (recursively) and writes the index to
+    // `output`. With `pack` set the files are copied into `output` as well, which then no
+    // longer needs the directory. Patterns are named after their file; a repeated name gets a
+    // " (2)", " (3)"... suffix. Files that are not patterns or fail to parse are skipped.
+    inline BuildResult build(const std::string& directory, const std::string& output, bool pack) {
+        namespace fs = std::filesystem;
+        struct Source {
+            std::string name;
+            fs::path file;
+            std::string path;
+            std::string rule;
+            PatternImport::Format format;
+            int width;
+            int height;
+            uint64_t population;
+        };
+
+        BuildResult result;
+        std::vector<fs::path> files;
+        for (const auto& item : fs::recursive_directory_iterator(directory)) {
+            const std::string extension = item.path().extension().string();
+            if (item.is_regular_file() && extension != ".golidx" && extension != ".golpack") {
+                files.push_back(item.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+
+        std::vector<Source> sources;
+        std::unordered_map<std::string, int> nameUses;
+        for (const fs::path& file : files) {
+            try {
+                const MappedFile mapped(file.string());
+                const PatternImport::Format format = PatternImport::detect(mapped.data(), mapped.size(), file.string());
+                if (format == PatternImport::Format::Unknown) {
+                    ++result.skipped;
+                    continue;
+                }
+                TiledEngine::Universe universe;
+                universe.setTracking(true);
+                const PatternImport::Info info = PatternImport::parse(mapped.data(), mapped.size(), format, universe);
+                const UniverseHash::BoundingBox& box = universe.getState().box;
+
+                std::string name = file.stem().string();
+                const int uses = ++nameUses[name];
+                if (uses > 1) {
+                    name += " (" + std::to_string(uses) + ")";
+                }
+                sources.push_back({ name, file, fs::relative(file, directory).generic_string(), info.rule, format,
+                                    box.isEmpty() ? 0 : box.maxX - box.minX + 1, box.isEmpty() ? 0 : box.maxY - box.minY + 1,
+                                    uint64_t(universe.population()) });
+            }
+            catch (const std::runtime_error&) {
+                ++result.skipped;
+            }
+        }
+        std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) { return a.name < b.name; });
+
+        std::string strings;
+        auto addString = [&](const std::string& text) {
+            const uint64_t offset = strings.size();
+            strings += text;
+            if (strings.size() > UINT32_MAX) {
+                throw std::runtime_error("Pattern library string table is too large");
+            }
+            return uint32_t(offset);
+        };
+        std::vector<Entry> entries(sources.size());
+        for (size_t i = 0; i < sources.size(); ++i) {
+            Entry& entry = entries[i];
+            entry = Entry{};
+            entry.nameOffset = addString(sources[i].name);
+            entry.nameLength = uint32_t(sources[i].name.size());
+            entry.ruleOffset = addString(sources[i].rule);
+            entry.ruleLength = uint32_t(sources[i].rule.size());
+            entry.width = sources[i].width;
+            entry.height = sources[i].height;
+            entry.population = sources[i].population;
+            entry.format = uint32_t(sources[i].format);
+            if (!pack) {
+                entry.dataOffset = addString(sources[i].path);
+                entry.dataSize = sources[i].path.size();
+            }
+        }
+
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.byteOrder = byteOrderMark;
+        header.entryCount = entries.size();
+        header.entriesOffset = sizeof(Header);
+        header.stringsOffset = sizeof(Header) + sizeof(Entry) * entries.size();
+        header.stringsSize = strings.size();
+        header.packed = pack;
+
+        if (pack) {
+            uint64_t offset = header.stringsOffset + strings.size();
+            for (size_t i = 0; i < sources.size(); ++i) {
+                entries[i].dataOffset = offset;
+                entries[i].dataSize = fs::file_size(sources[i].file);
+                offset += entries[i].dataSize;
+            }
+        }
+
+        PatternExport::BufferedWriter out(output);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries.data()), sizeof(Entry) * entries.size());
+        out.write(strings.data(), strings.size());
+        for (size_t i = 0; pack && i < sources.size(); ++i) {
+            const MappedFile mapped(sources[i].file.string());
+            if (mapped.size() != entries[i].dataSize) {
+                throw std::runtime_error(sources[i].path + " changed while the library was being packed");
+            }
+            out.write(mapped.data(), mapped.size());
+        }
+        out.close();
+        result.indexed = entries.size();
+        return result;
+    }
+
+    // An opened index or archive. Opening costs the same for any number of patterns: names
+    // and metadata are read straight out of the mapping when asked for. Not thread-safe.
+    class Library {
+    public:
+        Library() = default;
+
+        // Opens an archive, an index file, or a directory. A directory without an index gets
+        // one built the first time; run the library build again after adding files to it.
+        explicit Library(const std::string& path, size_t cacheCapacity = defaultCacheSize)
+            : capacity(std::max<size_t>(cacheCapacity, 1)) {
+            namespace fs = std::filesystem;
+            std::string indexPath = path;
+            if (fs::is_directory(path)) {
+                indexPath = (fs::path(path) / indexName).string();
+                if (!fs::exists(indexPath)) {
+                    build(path, indexPath, false);
+                }
+            }
+            file = std::make_shared<MappedFile>(indexPath);
+            if (file->size() < sizeof(Header) || std::memcmp(file->data(), magic, sizeof(magic)) != 0) {
+                throw std::runtime_error(indexPath + " is not a pattern library");
+            }
+            std::memcpy(&header, file->data(), sizeof(header));
+            if (header.version != version || header.byteOrder != byteOrderMark) {
+                throw std::runtime_error(indexPath + " was written by an incompatible version or platform");
+            }
+            if (header.entriesOffset > file->size() || header.entryCount > (file->size() - header.entriesOffset) / sizeof(Entry) ||
+                header.stringsOffset > file->size() || header.stringsSize > file->size() - header.stringsOffset) {
+                throw std::runtime_error(indexPath + " is truncated");
+            }
+            directory = fs::path(indexPath).parent_path().string();
+        }
+
+        // The cache holds iterators into its own list, so a library moves but does not copy.
+        Library(Library&&) = default;
+        Library& operator=(Library&&) = default;
+        Library(const Library&) = delete;
+        Library& operator=(const Library&) = delete;
+
+        size_t size() const {
+            return size_t(header.entryCount);
+        }
+
+        Entry entry(size_t index) const {
+            if (index >= size()) {
+                throw std::invalid_argument("Pattern index out of range");
+            }
+            Entry result;
+            std::memcpy(&result, file->data() + header.entriesOffset + sizeof(Entry) * index, sizeof(result));
+            return result;
+        }
+
+        std::string name(size_t index) const {
+            const Entry found = entry(index);
+            return text(found.nameOffset, found.nameLength);
+        }
+
+        // The rule the pattern's file names, or "" when it names none.
+        std::string rule(size_t index) const {
+            const Entry found = entry(index);
+            return text(found.ruleOffset, found.ruleLength);
+        }
+
+        // Binary search over the sorted names. Returns size() when there is no such pattern.
+        size_t find(const std::string& patternName) const {
+            size_t low = 0, high = size();
+            while (low < high) {
+                const size_t middle = low + (high - low) / 2;
+                if (name(middle) < patternName) {
+                    low = middle + 1;
+                }
+                else {
+                    high = middle;
+                }
+            }
+            return low < size() && name(low) == patternName ? low : size();
+        }
+
+        // Returns the pattern's cells, reading and parsing its file on a cache miss. The least
+        // recently used pattern is dropped once the cache holds more than its capacity.
+        Pattern get(size_t index) {
+            const auto cached = lookup.find(index);
+            if (cached != lookup.end()) {
+                recent.splice(recent.begin(), recent, cached->second);
+                return cached->second->second;
+            }
+
+            const Entry found = entry(index);
+            if (found.format >= uint32_t(PatternImport::Format::Unknown)) {
+                throw std::runtime_error("Pattern library entry has an unknown format");
+            }
+            auto universe = std::make_shared<TiledEngine::Universe>();
+            if (header.packed) {
+                if (found.dataOffset > file->size() || found.dataSize > file->size() - found.dataOffset) {
+                    throw std::runtime_error("Pattern library entry lies outside the archive");
+                }
+                PatternImport::parse(file->data() + found.dataOffset, size_t(found.dataSize),
+                                     PatternImport::Format(found.format), *universe);
+            }
+            else {
+                const MappedFile source((std::filesystem::path(directory) / text(found.dataOffset, found.dataSize)).string());
+                PatternImport::parse(source.data(), source.size(), PatternImport::Format(found.format), *universe);
+            }
+
+            recent.emplace_front(index, universe);
+            lookup[index] = recent.begin();
+            if (recent.size() > capacity) {
+                lookup.erase(recent.back().first);
+                recent.pop_back();
+            }
+            return universe;
+        }
+
+        size_t cachedCount() const {
+            return recent.size();
+        }
+
+    private:
+        std::string text(uint64_t offset, uint64_t length) const {
+            if (offset > header.stringsSize || length > header.stringsSize - offset) {
+                throw std::runtime_error("Pattern library has a corrupt string table");
+            }
+            return std::string(file->data() + header.stringsOffset + offset, size_t(length));
+        }
+
+        std::shared_ptr<MappedFile> file;
+        Header header{};
+        std::string directory;
+        size_t capacity = defaultCacheSize;
+        std::list<std::pair<size_t, Pattern>> recent;
+        std::unordered_map<size_t, std::list<std::pair<size_t, Pattern>>::iterator> lookup;
+    };
+
+} // namespace PatternLibrary
@@ -0,0 +1,329 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "PatternExport.h"
+#include "PatternImport.h"
+#include "TiledEngine.h"
+
+// Copy, cut, paste, rotate, mirror and boolean composition of rectangular regions, done on
+// whole 64x64 tiles with word operations rather than on cells.
+//
+// A clip keeps its cells in tiles aligned to its own top-left corner. Reading or writing a
+// 64x64 block at any other offset touches at most four tiles and costs one shift and OR per
+// row, so copying and pasting run at memory speed whatever the alignment. Rotation
+// transposes each tile as a bit matrix, mirroring reverses bits or rows, and pasting
+// combines rows with OR, AND, XOR or replacement. Clips travel through the clipboard as RLE.
+namespace Selection {
+
+    using TiledEngine::Tile;
+    using TiledEngine::TileKey;
+    using TiledEngine::TileKeyHash;
+    using TiledEngine::tileSize;
+
+    // The cells of a width x height rectangle, with its top-left cell at (0, 0).
+    struct Clip {
+        TiledEngine::Universe cells;
+        int width = 0;
+        int height = 0;
+
+        bool empty() const {
+            return width <= 0 || height <= 0;
+        }
+    };
+
+    enum class Mode {
+        Or,
+        And,
+        Xor,
+        Replace
+    };
+
+    // A rectangle of cells: [x, x + width) x [y, y + height).
+    struct Rect {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+
+        bool empty() const {
+            return width <= 0 || height <= 0;
+        }
+    };
+
+    // Transposes a 64x64 bit matrix in place, so that bit c of row r moves to bit r of row c.
+    // Each of the six rounds swaps the off-diagonal blocks of every 2j x 2j block with one
+    // masked shift and two XORs per row pair, 64 cells at a time.
+    inline void transpose(Tile& tile) {
+        uint64_t mask = 0x00000000FFFFFFFFull;
+        for (int j = 32; j != 0; j >>= 1, mask ^= mask << j) {
+            for (int k = 0; k < tileSize; k = ((k | j) + 1) & ~j) {
+                const uint64_t swap = ((tile.rows[k] >> j) ^ tile.rows[k | j]) & mask;
+                tile.rows[k] ^= swap << j;
+                tile.rows[k | j] ^= swap;
+            }
+        }
+    }
+
+    // Bits [from, to) of a word, for 0 <= from <= to <= 64.
+    inline uint64_t bitRange(int from, int to) {
+        if (from >= to) {
+            return 0;
+        }
+        const uint64_t upTo = to >= tileSize ? ~uint64_t(0) : (uint64_t(1) << to) - 1;
+        return upTo & ~((uint64_t(1) << from) - 1);
+    }
+
+    // The 64x64 block of `universe` whose top-left cell is (x, y), from the up to four tiles
+    // it overlaps.
+    inline Tile gather(const TiledEngine::Universe& universe, long long x, long long y) {
+        Tile block{};
+        const int tileX = TiledEngine::tileCoord(int(x)), tileY = TiledEngine::tileCoord(int(y));
+        const int shiftX = TiledEngine::inTile(int(x)), shiftY = TiledEngine::inTile(int(y));
+        const Tile* sources[2][2] = {
+            { universe.findTile({ tileX, tileY }), universe.findTile({ tileX + 1, tileY }) },
+            { universe.findTile({ tileX, tileY + 1 }), universe.findTile({ tileX + 1, tileY + 1 }) }
+        };
+        for (int r = 0; r < tileSize; ++r) {
+            const int half = shiftY + r >= tileSize;
+            const int row = (shiftY + r) & (tileSize - 1);
+            const Tile* left = sources[half][0];
+            const Tile* right = sources[half][1];
+            uint64_t word = left ? left->rows[row] >> shiftX : 0;
+            if (shiftX && right) {
+                word |= right->rows[row] << (tileSize - shiftX);
+            }
+            block.rows[r] = word;
+        }
+        return block;
+    }
+
+    // The tiles of `universe` that hold live cells inside `rect`, found by looking each
+    // position up or by scanning the map, whichever visits fewer tiles.
+    inline std::vector<TileKey> tilesIn(const TiledEngine::Universe& universe, const Rect& rect) {
+        std::vector<TileKey> keys;
+        if (rect.empty()) {
+            return keys;
+        }
+        const int firstX = TiledEngine::tileCoord(rect.x), lastX = TiledEngine::tileCoord(rect.x + rect.width - 1);
+        const int firstY = TiledEngine::tileCoord(rect.y), lastY = TiledEngine::tileCoord(rect.y + rect.height - 1);
+        const long long span = (long long)(lastX - firstX + 1) * (lastY - firstY + 1);
+        if (span <= (long long)universe.getTiles().size()) {
+            for (int ty = firstY; ty <= lastY; ++ty) {
+                for (int tx = firstX; tx <= lastX; ++tx) {
+                    if (universe.findTile({ tx, ty })) {
+                        keys.push_back({ tx, ty });
+                    }
+                }
+            }
+        }
+        else {
+            for (const auto& entry : universe.getTiles()) {
+                const TileKey& key = entry.first;
+                if (key.x >= firstX && key.x <= lastX && key.y >= firstY && key.y <= lastY) {
+                    keys.push_back(key);
+                }
+            }
+        }
+        return keys;
+    }
+
+    // Which cells of tile `key` lie inside `rect`, as a tile of set bits.
+    inline Tile coverage(const TileKey& key, const Rect& rect) {
+        Tile mask{};
+        const long long originX = (long long)key.x * tileSize, originY = (long long)key.y * tileSize;
+        const int from = int(std::clamp<long long>(rect.x - originX, 0, tileSize));
+        const int to = int(std::clamp<long long>((long long)rect.x + rect.width - originX, 0, tileSize));
+        const uint64_t columns = bitRange(from, to);
+        for (int r = 0; r < tileSize; ++r) {
+            const long long y = originY + r;
+            mask.rows[r] = y >= rect.y && y < (long long)rect.y + rect.height ? columns : 0;
+        }
+        return mask;
+    }
+
+    // Copies the cells of `rect` into a clip.
+    inline Clip copy(const TiledEngine::Universe& universe, const Rect& rect) {
+        Clip clip;
+        clip.width = std::max(rect.width, 0);
+        clip.height = std::max(rect.height, 0);
+        // Every source tile in the rectangle lands on up to four clip tiles.
+        std::unordered_set<TileKey, TileKeyHash> targets;
+        for (const TileKey& key : tilesIn(universe, rect)) {
+            const int clipX = TiledEngine::tileCoord(key.x * tileSize - rect.x);
+            const int clipY = TiledEngine::tileCoord(key.y * tileSize - rect.y);
+            for (int dy = 0; dy <= 1; ++dy) {
+                for (int dx = 0; dx <= 1; ++dx) {
+                    targets.insert({ clipX + dx, clipY + dy });
+                }
+            }
+        }
+        const Rect bounds{ 0, 0, clip.width, clip.height };
+        for (const TileKey& target : targets) {
+            if (target.x < 0 || target.y < 0 || (long long)target.x * tileSize >= clip.width || (long long)target.y * tileSize >= clip.height) {
+                continue;
+            }
+            Tile block = gather(universe, (long long)rect.x + (long long)target.x * tileSize, (long long)rect.y + (long long)target.y * tileSize);
+            const Tile mask = coverage(target, bounds);
+            for (int r = 0; r < tileSize; ++r) {
+                block.rows[r] &= mask.rows[r];
+            }
+            clip.cells.putTile(target, block);
+        }
+        return clip;
+    }
+
+    // Combines `clip` into `universe` with its top-left cell at (x, y). OR and XOR only touch
+    // tiles the clip has cells for; AND and Replace also clear cells the clip leaves dead.
+    inline void paste(TiledEngine::Universe& universe, const Clip& clip, int x, int y, Mode mode) {
+        if (clip.empty()) {
+            return;
+        }
+        const Rect rect{ x, y, clip.width, clip.height };
+        std::unordered_set<TileKey, TileKeyHash> targets;
+        for (const auto& entry : clip.cells.getTiles()) {
+            const int tileX = TiledEngine::tileCoord(x + entry.first.x * tileSize);
+            const int tileY = TiledEngine::tileCoord(y + entry.first.y * tileSize);
+            for (int dy = 0; dy <= 1; ++dy) {
+                for (int dx = 0; dx <= 1; ++dx) {
+                    targets.insert({ tileX + dx, tileY + dy });
+                }
+            }
+        }
+        if (mode == Mode::And || mode == Mode::Replace) {
+            for (const TileKey& key : tilesIn(universe, rect)) {
+                targets.insert(key);
+            }
+        }
+
+        for (const TileKey& key : targets) {
+            const Tile mask = coverage(key, rect);
+            Tile block = gather(clip.cells, (long long)key.x * tileSize - x, (long long)key.y * tileSize - y);
+            const Tile* current = universe.findTile(key);
+            Tile tile = current ? *current : Tile{};
+            for (int r = 0; r < tileSize; ++r) {
+                const uint64_t incoming = block.rows[r] & mask.rows[r];
+                switch (mode) {
+                case Mode::Or: tile.rows[r] |= incoming; break;
+                case Mode::And: tile.rows[r] &= incoming | ~mask.rows[r]; break;
+                case Mode::Xor: tile.rows[r] ^= incoming; break;
+                case Mode::Replace: tile.rows[r] = (tile.rows[r] & ~mask.rows[r]) | incoming; break;
+                }
+            }
+            if (!current || tile != *current) {
+                universe.putTile(key, tile);
+            }
+        }
+    }
+
+    // Kills every cell of `rect`.
+    inline void clear(TiledEngine::Universe& universe, const Rect& rect) {
+        for (const TileKey& key : tilesIn(universe, rect)) {
+            const Tile mask = coverage(key, rect);
+            Tile tile = *universe.findTile(key);
+            for (int r = 0; r < tileSize; ++r) {
+                tile.rows[r] &= ~mask.rows[r];
+            }
+            universe.putTile(key, tile);
+        }
+    }
+
+    // Mirrors the clip so that (x, y) becomes (y, x); width and height swap.
+    inline Clip transposed(const Clip& clip) {
+        Clip result;
+        result.width = clip.height;
+        result.height = clip.width;
+        for (const auto& entry : clip.cells.getTiles()) {
+            Tile tile = *entry.second;
+            transpose(tile);
+            result.cells.putTile({ entry.first.y, entry.first.x }, tile);
+        }
+        return result;
+    }
+
+    // Mirrors the clip left to right (`horizontal`) or top to bottom. The mirror is taken over
+    // the clip's whole tiles, where it only reverses bits or rows, and then shifted back by
+    // the padding beyond the clip's edge.
+    inline Clip mirrored(const Clip& clip, bool horizontal) {
+        const int tilesWide = (clip.width + tileSize - 1) / tileSize;
+        const int tilesHigh = (clip.height + tileSize - 1) / tileSize;
+        Clip padded;
+        padded.width = tilesWide * tileSize;
+        padded.height = tilesHigh * tileSize;
+        for (const auto& entry : clip.cells.getTiles()) {
+            Tile tile = *entry.second;
+            TileKey key = entry.first;
+            if (horizontal) {
+                for (uint64_t& row : tile.rows) {
+                    row = LifeKernel::reverseBits(row);
+                }
+                key.x = tilesWide - 1 - key.x;
+            }
+            else {
+                std::reverse(tile.rows.begin(), tile.rows.end());
+                key.y = tilesHigh - 1 - key.y;
+            }
+            padded.cells.putTile(key, tile);
+        }
+        const Rect inside{ horizontal ? padded.width - clip.width : 0, horizontal ? 0 : padded.height - clip.height, clip.width, clip.height };
+        return inside.x == 0 && inside.y == 0 ? Clip{ padded.cells, clip.width, clip.height } : copy(padded.cells, inside);
+    }
+
+    // A quarter turn clockwise (screen coordinates, y pointing down) or counterclockwise.
+    inline Clip rotated(const Clip& clip, bool clockwise) {
+        return clockwise ? transposed(mirrored(clip, false)) : mirrored(transposed(clip), false);
+    }
+
+    // The live cells of `universe` as a clip cropped to their bounding box, and that box's
+    // top-left corner, so pasting the clip there puts them back where they were.
+    inline Clip crop(const TiledEngine::Universe& universe, int& originX, int& originY) {
+        UniverseHash::BoundingBox box;
+        for (const auto& entry : universe.getTiles()) {
+            box.merge(entry.second->boundingBox(entry.first.x * tileSize, entry.first.y * tileSize));
+        }
+        originX = box.isEmpty() ? 0 : box.minX;
+        originY = box.isEmpty() ? 0 : box.minY;
+        if (box.isEmpty()) {
+            return Clip();
+        }
+        return copy(universe, Rect{ box.minX, box.minY, box.maxX - box.minX + 1, box.maxY - box.minY + 1 });
+    }
+
+    // The clip as RLE, keeping its full size even when its edges are dead.
+    inline std::string toRle(const Clip& clip, const std::string& rule = "B3/S23") {
+        PatternExport::StringWriter out;
+        const int tilesWide = (clip.width + tileSize - 1) / tileSize;
+        PatternExport::writeRle(out, 0, 0, clip.width, clip.height, rule, [&](long long y, const auto& emit) {
+            const int tileY = int(y / tileSize), r = int(y % tileSize);
+            for (int tileX = 0; tileX < tilesWide; ++tileX) {
+                if (const Tile* tile = clip.cells.findTile({ tileX, tileY })) {
+                    emit((long long)tileX * tileSize, tile->rows[r]);
+                }
+            }
+        });
+        return out.text;
+    }
+
+    // Reads a clip from pattern text in any format PatternImport knows, such as RLE taken from
+    // the clipboard. An RLE header's size is kept; other formats are cropped to their cells.
+    // Throws std::runtime_error when the text is not a pattern.
+    inline Clip fromText(const std::string& text) {
+        const PatternImport::Format format = PatternImport::detect(text.data(), text.size());
+        if (format == PatternImport::Format::Unknown) {
+            throw std::runtime_error("The text is not a pattern");
+        }
+        TiledEngine::Universe cells;
+        const PatternImport::Info info = PatternImport::parse(text.data(), text.size(), format, cells);
+        int originX = 0, originY = 0;
+        Clip clip = crop(cells, originX, originY);
+        if (format == PatternImport::Format::Rle && originX >= 0 && originY >= 0 &&
+            info.width >= originX + clip.width && info.height >= originY + clip.height) {
+            clip = copy(cells, Rect{ 0, 0, info.width, info.height });
+        }
+        return clip;
+    }
+
+} // namespace Selection
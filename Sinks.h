@@ -0,0 +1,285 @@
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "Selection.h"
+#include "TiledEngine.h"
+
+// Removal of the spaceships a pattern sends off, so that guns can run for millions of
+// generations in constant memory and constant time per step.
+//
+// A collector knows the home rectangle where the pattern of interest lives. Every few
+// generations it looks at the tiles that reach beyond the home rectangle grown by a margin,
+// groups their cells into objects (cells at most two apart belong together, which keeps
+// every phase of the usual spaceships in one piece) and names each object by comparing its
+// shape with the phases of the known spaceships under all eight rotations and reflections.
+// Recognised spaceships lying wholly outside are deleted and counted by name and by the
+// compass direction they left home in. Objects touching one of the optional sink rectangles
+// are deleted wherever they are, whatever they are.
+//
+// Anything else outside home, such as still lifes, oscillators, debris or a pattern the user
+// placed far away, is left alone, and so are objects larger than maxObjectCells.
+namespace Sinks {
+
+    using Cells = std::vector<std::pair<int, int>>;
+
+    // The shape of a set of cells regardless of position, rotation and reflection: the
+    // smallest of the eight normalized, sorted cell lists.
+    inline std::vector<uint64_t> canonical(const Cells& cells) {
+        std::vector<uint64_t> best;
+        for (int transform = 0; transform < 8; ++transform) {
+            Cells moved;
+            moved.reserve(cells.size());
+            for (const auto& cell : cells) {
+                int x = cell.first, y = cell.second;
+                if (transform & 1) x = -x;
+                if (transform & 2) y = -y;
+                if (transform & 4) std::swap(x, y);
+                moved.push_back({ x, y });
+            }
+            int minX = INT_MAX, minY = INT_MAX;
+            for (const auto& cell : moved) {
+                minX = std::min(minX, cell.first);
+                minY = std::min(minY, cell.second);
+            }
+            std::vector<uint64_t> packed;
+            packed.reserve(moved.size());
+            for (const auto& cell : moved) {
+                packed.push_back((uint64_t(uint32_t(cell.second - minY)) << 32) | uint32_t(cell.first - minX));
+            }
+            std::sort(packed.begin(), packed.end());
+            if (best.empty() || packed < best) {
+                best = std::move(packed);
+            }
+        }
+        return best;
+    }
+
+    // Every phase of the glider and the three standard spaceships, by canonical shape.
+    inline const std::map<std::vector<uint64_t>, std::string>& spaceships() {
+        static const std::map<std::vector<uint64_t>, std::string> catalog = []() {
+            const std::pair<const char*, const char*> ships[] = {
+                { "glider", ".O.\n..O\nOOO" },
+                { "LWSS", ".O..O\nO....\nO...O\nOOOO." },
+                { "MWSS", "...O..\n.O...O\nO.....\nO....O\nOOOOO." },
+                { "HWSS", "...OO..\n.O....O\nO......\nO.....O\nOOOOOO." },
+            };
+            std::map<std::vector<uint64_t>, std::string> shapes;
+            for (const auto& ship : ships) {
+                TiledEngine::Universe universe;
+                int x = 0, y = 0;
+                for (const char* c = ship.second; *c; ++c) {
+                    if (*c == '\n') {
+                        x = 0;
+                        ++y;
+                        continue;
+                    }
+                    universe.set(x++, y, *c == 'O');
+                }
+                for (int phase = 0; phase < 4; ++phase) {
+                    Cells cells;
+                    universe.forEachAlive([&](int cx, int cy) { cells.push_back({ cx, cy }); });
+                    shapes[canonical(cells)] = ship.first;
+                    universe.step();
+                }
+            }
+            return shapes;
+        }();
+        return catalog;
+    }
+
+    inline std::string nameOf(const Cells& cells) {
+        const auto& catalog = spaceships();
+        const auto it = catalog.find(canonical(cells));
+        return it == catalog.end() ? "other" : it->second;
+    }
+
+    class Collector {
+    public:
+        static constexpr size_t maxObjectCells = 256;
+        static constexpr int defaultMargin = 64;
+        static constexpr uint64_t defaultInterval = 16;
+
+        // `home` is where the pattern of interest lives. With `automatic` off, only objects
+        // touching a sink are collected.
+        explicit Collector(const Selection::Rect& home, int margin = defaultMargin, bool automatic = true)
+            : home(home), margin(std::max(margin, 2)), automatic(automatic) {
+        }
+
+        void addSink(const Selection::Rect& sink) {
+            if (!sink.empty()) {
+                sinks.push_back(sink);
+            }
+        }
+
+        // Collects every `generations` generations, so a ship travels at most that many cells
+        // past the boundary before it goes.
+        void setInterval(uint64_t generations) {
+            interval = std::max<uint64_t>(generations, 1);
+        }
+
+        // Call after every step. Returns the number of cells removed.
+        size_t collect(TiledEngine::Universe& universe) {
+            if (universe.getGeneration() < nextSweep) {
+                return 0;
+            }
+            nextSweep = universe.getGeneration() + interval;
+
+            const Selection::Rect kept = boundary();
+            std::unordered_set<uint64_t> seen;
+            std::vector<std::pair<Cells, std::string>> doomed;
+            for (const auto& entry : universe.getTiles()) {
+                const TiledEngine::TileKey& key = entry.first;
+                const Selection::Rect tile{ key.x * TiledEngine::tileSize, key.y * TiledEngine::tileSize, TiledEngine::tileSize, TiledEngine::tileSize };
+                const bool outside = automatic && !contains(kept, tile);
+                const bool sinking = std::any_of(sinks.begin(), sinks.end(), [&](const Selection::Rect& sink) { return overlaps(sink, tile); });
+                if (!outside && !sinking) {
+                    continue;
+                }
+                for (int r = 0; r < TiledEngine::tileSize; ++r) {
+                    for (uint64_t bits = entry.second->rows[r]; bits; bits &= bits - 1) {
+                        const int x = tile.x + LifeKernel::countTrailingZeros(bits), y = tile.y + r;
+                        Cells object;
+                        if (!seen.count(cellKey(x, y)) && gather(universe, x, y, seen, object)) {
+                            std::string name = nameOf(object);
+                            if (escaped(object, name, kept)) {
+                                doomed.push_back({ std::move(object), std::move(name) });
+                            }
+                        }
+                    }
+                }
+            }
+
+            size_t removed = 0;
+            for (const auto& object : doomed) {
+                for (const auto& cell : object.first) {
+                    universe.set(cell.first, cell.second, false);
+                }
+                removed += object.first.size();
+                ++counts[object.second + " " + direction(object.first)];
+            }
+            removedCells += removed;
+            return removed;
+        }
+
+        // Objects collected so far, by name and direction, e.g. "glider SE".
+        const std::map<std::string, uint64_t>& getCounts() const {
+            return counts;
+        }
+
+        uint64_t getRemovedCells() const {
+            return removedCells;
+        }
+
+        // One line such as "Collected 12 glider SE, 1 other N".
+        std::string describe() const {
+            std::ostringstream out;
+            out << "Collected";
+            bool first = true;
+            for (const auto& entry : counts) {
+                out << (first ? " " : ", ") << entry.second << " " << entry.first;
+                first = false;
+            }
+            return first ? "Collected nothing yet" : out.str();
+        }
+
+    private:
+        static uint64_t cellKey(int x, int y) {
+            return (uint64_t(uint32_t(y)) << 32) | uint32_t(x);
+        }
+
+        static bool contains(const Selection::Rect& outer, const Selection::Rect& inner) {
+            return (long long)inner.x >= outer.x && (long long)inner.y >= outer.y &&
+                   (long long)inner.x + inner.width <= (long long)outer.x + outer.width &&
+                   (long long)inner.y + inner.height <= (long long)outer.y + outer.height;
+        }
+
+        static bool overlaps(const Selection::Rect& a, const Selection::Rect& b) {
+            return (long long)a.x < (long long)b.x + b.width && (long long)b.x < (long long)a.x + a.width &&
+                   (long long)a.y < (long long)b.y + b.height && (long long)b.y < (long long)a.y + a.height;
+        }
+
+        static bool inside(const Selection::Rect& rect, int x, int y) {
+            return x >= rect.x && y >= rect.y && (long long)x < (long long)rect.x + rect.width && (long long)y < (long long)rect.y + rect.height;
+        }
+
+        Selection::Rect boundary() const {
+            return { home.x - margin, home.y - margin, home.width + 2 * margin, home.height + 2 * margin };
+        }
+
+        // Collects the object around (x, y) into `object`. Returns false, leaving its cells
+        // marked as seen, when it grows past maxObjectCells.
+        static bool gather(const TiledEngine::Universe& universe, int x, int y, std::unordered_set<uint64_t>& seen, Cells& object) {
+            std::vector<std::pair<int, int>> stack{ { x, y } };
+            seen.insert(cellKey(x, y));
+            bool small = true;
+            while (!stack.empty()) {
+                const auto cell = stack.back();
+                stack.pop_back();
+                if (small) {
+                    object.push_back(cell);
+                    small = object.size() <= maxObjectCells;
+                }
+                for (int dy = -2; dy <= 2; ++dy) {
+                    for (int dx = -2; dx <= 2; ++dx) {
+                        const int nx = cell.first + dx, ny = cell.second + dy;
+                        if (universe.get(nx, ny) && seen.insert(cellKey(nx, ny)).second) {
+                            stack.push_back({ nx, ny });
+                        }
+                    }
+                }
+            }
+            if (!small) {
+                object.clear();
+            }
+            return small;
+        }
+
+        // Whether `object`, named `name`, goes: it touches a sink, or it is a known spaceship
+        // that has left the kept rectangle.
+        bool escaped(const Cells& object, const std::string& name, const Selection::Rect& kept) const {
+            const bool touchesSink = std::any_of(object.begin(), object.end(), [&](const std::pair<int, int>& cell) {
+                return std::any_of(sinks.begin(), sinks.end(), [&](const Selection::Rect& sink) { return inside(sink, cell.first, cell.second); });
+            });
+            if (touchesSink) {
+                return true;
+            }
+            return automatic && name != "other" && std::none_of(object.begin(), object.end(), [&](const std::pair<int, int>& cell) {
+                return inside(kept, cell.first, cell.second);
+            });
+        }
+
+        // The compass point of the object seen from the centre of home.
+        std::string direction(const Cells& object) const {
+            double x = 0, y = 0;
+            for (const auto& cell : object) {
+                x += cell.first;
+                y += cell.second;
+            }
+            x = x / object.size() - (home.x + home.width / 2.0);
+            y = y / object.size() - (home.y + home.height / 2.0);
+            static const char* const names[] = { "E", "SE", "S", "SW", "W", "NW", "N", "NE" };
+            const double angle = std::atan2(y, x);
+            const int sector = int(std::lround(angle / (3.14159265358979323846 / 4))) & 7;
+            return names[sector];
+        }
+
+        Selection::Rect home;
+        int margin;
+        bool automatic;
+        std::vector<Selection::Rect> sinks;
+        uint64_t interval = defaultInterval;
+        uint64_t nextSweep = 0;
+        std::map<std::string, uint64_t> counts;
+        uint64_t removedCells = 0;
+    };
+
+} // namespace Sinks
@@ -0,0 +1,265 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "BitSlicedEngine.h"
+#include "Census.h"
+#include "Parallel.h"
+#include "TiledEngine.h"
+
+// Headless random-soup search in the style of apgsearch: seeded 16x16 soups are run to
+// stabilization on every core, their ash is separated into objects and every object is
+// counted by canonical code.
+namespace SoupSearch {
+
+    // SplitMix64, a small fast generator whose output only depends on the state it is given,
+    // so soup i of a search is the same whatever thread happens to run it.
+    inline uint64_t splitMix64(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Fills a size x size square at the origin with soup number `index` of search `seed`,
+    // each cell alive with probability 1/2.
+    template <typename Universe>
+    void placeSoup(Universe& universe, uint64_t seed, uint64_t index, int size = 16) {
+        uint64_t state = seed * 0xD1B54A32D192ED03ull + index;
+        uint64_t bits = 0;
+        int available = 0;
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                if (available == 0) {
+                    bits = splitMix64(state);
+                    available = 64;
+                }
+                universe.set(x, y, bits & 1);
+                bits >>= 1;
+                --available;
+            }
+        }
+    }
+
+    struct Options {
+        uint64_t soups = 10000;
+        uint64_t seed = 1;
+        unsigned threads = 0;
+        int soupSize = 16;
+        int maxGenerations = 20000;
+        LifeKernel::Rule rule;
+        // 0 runs one soup at a time on the tiled engine; 64, 256 or 512 runs that many soups
+        // side by side in a bit-sliced batch of batchSize x batchSize cells per soup.
+        int lanes = 0;
+        int batchSize = 64;
+    };
+
+    struct Result {
+        Census::Table census;
+        double seconds = 0.0;
+        unsigned threads = 0;
+
+        double soupsPerSecond() const {
+            return seconds > 0.0 ? double(census.soups) / seconds : 0.0;
+        }
+
+        double soupsPerSecondPerCore() const {
+            return threads ? soupsPerSecond() / double(threads) : 0.0;
+        }
+    };
+
+    // Worker-local classification cache keyed by the position-independent hash of an object
+    // in the phase it was found in, so common ash (blocks, blinkers, beehives...) is only
+    // ever simulated once per thread.
+    using ClassificationCache = std::unordered_map<uint64_t, std::string>;
+
+    inline uint64_t objectKey(const Census::Cells& object) {
+        const UniverseHash::State state = UniverseHash::stateOf(object, 0);
+        return state.normalizedHash() ^ (uint64_t(state.population) * 0x9E3779B97F4A7C15ull);
+    }
+
+    // Adds the ash of a universe that has settled with the given period to `table`.
+    inline void censusAsh(TiledEngine::Universe& universe, int period, Census::Table& table,
+                          ClassificationCache& cache, const LifeKernel::Rule& rule) {
+        for (const Census::Cells& object : Census::separate(universe, period)) {
+            const uint64_t key = objectKey(object);
+            auto it = cache.find(key);
+            if (it == cache.end()) {
+                it = cache.emplace(key, Census::classify(object, rule)).first;
+            }
+            if (!it->second.empty()) {
+                table.add(it->second);
+            }
+        }
+    }
+
+    // Runs soups one at a time until the shared counter runs out.
+    inline void runSoups(const Options& options, std::atomic<uint64_t>& nextSoup, Census::Table& table,
+                         ClassificationCache& cache) {
+        for (uint64_t soup = nextSoup++; soup < options.soups; soup = nextSoup++) {
+            TiledEngine::Universe universe(options.rule);
+            universe.setSerial(true);
+            placeSoup(universe, options.seed, soup, options.soupSize);
+            const int period = Census::stabilize(universe, options.maxGenerations);
+            ++table.soups;
+            if (period == 0) {
+                ++table.unstabilized;
+                continue;
+            }
+            censusAsh(universe, period, table, cache, options.rule);
+        }
+    }
+
+    // One lane of a batch seen as a universe, so placeSoup can fill it. Counts the cells it
+    // sets alive, which is the population of the fresh soup.
+    template <int Words>
+    struct LaneWriter {
+        BitSlicedEngine::Batch<Words>& batch;
+        int lane;
+        int origin;
+        size_t population = 0;
+
+        void set(int x, int y, bool alive) {
+            batch.set(lane, origin + x, origin + y, alive);
+            population += alive;
+        }
+    };
+
+    // Runs soups 64 * Words at a time in a bit-sliced batch. Every lane keeps its own
+    // population history; a lane whose soup has settled is censused and refilled with the
+    // next soup at once, so the batch never waits for its slowest soup. Soups that reach
+    // the edge of the batch move to the tiled engine and finish there from the generation
+    // they had reached, which gives exactly the census runSoups would.
+    template <int Words>
+    void runBatch(const Options& options, std::atomic<uint64_t>& nextSoup, Census::Table& table,
+                  ClassificationCache& cache) {
+        using Batch = BitSlicedEngine::Batch<Words>;
+        if (options.batchSize < options.soupSize + 2) {
+            throw std::invalid_argument("SoupSearch batch must be larger than the soup");
+        }
+        Batch batch(options.batchSize, options.batchSize, options.rule);
+        const int origin = (options.batchSize - options.soupSize) / 2;
+        std::vector<Census::PopulationHistory> histories(Batch::lanes);
+        std::vector<bool> active(Batch::lanes, false);
+        int activeCount = 0;
+
+        auto refill = [&](int lane) {
+            batch.clearLane(lane);
+            const uint64_t soup = nextSoup++;
+            active[size_t(lane)] = soup < options.soups;
+            if (!active[size_t(lane)]) {
+                --activeCount;
+                return;
+            }
+            LaneWriter<Words> writer{ batch, lane, origin };
+            placeSoup(writer, options.seed, soup, options.soupSize);
+            histories[size_t(lane)] = Census::PopulationHistory();
+            histories[size_t(lane)].record(writer.population);
+        };
+        auto extract = [&](int lane) {
+            TiledEngine::Universe universe(options.rule);
+            universe.setSerial(true);
+            batch.forEachAlive(lane, [&](int x, int y) { universe.set(x - origin, y - origin, true); });
+            return universe;
+        };
+        auto finish = [&](TiledEngine::Universe& universe, int period) {
+            ++table.soups;
+            if (period == 0) {
+                ++table.unstabilized;
+                return;
+            }
+            censusAsh(universe, period, table, cache, options.rule);
+        };
+
+        activeCount = Batch::lanes;
+        for (int lane = 0; lane < Batch::lanes; ++lane) {
+            refill(lane);
+        }
+        while (activeCount > 0) {
+            batch.step();
+            const auto populations = batch.populations();
+            const typename Batch::Mask edge = batch.edgeLanes();
+            for (int lane = 0; lane < Batch::lanes; ++lane) {
+                if (!active[size_t(lane)]) {
+                    continue;
+                }
+                Census::PopulationHistory& history = histories[size_t(lane)];
+                const int period = history.record(populations[size_t(lane)]);
+                if (period == 0 && history.generation() < options.maxGenerations && !Batch::contains(edge, lane)) {
+                    continue;
+                }
+                TiledEngine::Universe universe = extract(lane);
+                if (period == 0 && history.generation() < options.maxGenerations) {
+                    finish(universe, Census::stabilize(universe, history, options.maxGenerations));
+                }
+                else {
+                    finish(universe, period);
+                }
+                refill(lane);
+            }
+        }
+    }
+
+    // Runs soups [0, options.soups) of options.seed. Workers claim soups from a shared atomic
+    // counter and count objects in their own table; the tables are merged after all workers
+    // have finished. The workers already fill the cores, so their universes step serially.
+    inline Result search(const Options& options) {
+        const unsigned threads = options.threads ? options.threads : Parallel::workerCount();
+        std::vector<Census::Table> tables(threads);
+        std::atomic<uint64_t> nextSoup{ 0 };
+
+        void (*run)(const Options&, std::atomic<uint64_t>&, Census::Table&, ClassificationCache&) = nullptr;
+        switch (options.lanes) {
+        case 0: run = runSoups; break;
+        case 64: run = runBatch<1>; break;
+        case 256: run = runBatch<4>; break;
+        case 512: run = runBatch<8>; break;
+        default: throw std::invalid_argument("SoupSearch lanes must be 0, 64, 256 or 512");
+        }
+        auto worker = [&](unsigned id) {
+            ClassificationCache cache;
+            run(options, nextSoup, tables[id], cache);
+        };
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> pool;
+        for (unsigned id = 1; id < threads; ++id) {
+            pool.emplace_back(worker, id);
+        }
+        worker(0);
+        for (auto& thread : pool) {
+            thread.join();
+        }
+
+        Result result;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.threads = threads;
+        for (const Census::Table& table : tables) {
+            result.census.merge(table);
+        }
+        return result;
+    }
+
+    inline void printResult(const Result& result, std::ostream& out, size_t limit = 40) {
+        out << result.census.soups << " soups in " << result.seconds << " s on " << result.threads << " threads: "
+            << result.soupsPerSecond() << " soups/s, " << result.soupsPerSecondPerCore() << " soups/s/core\n";
+        if (result.census.unstabilized) {
+            out << result.census.unstabilized << " soups did not stabilize\n";
+        }
+        size_t shown = 0;
+        for (const auto& entry : result.census.sorted()) {
+            if (shown++ == limit) {
+                break;
+            }
+            out << "  " << entry.first << "  " << entry.second << "\n";
+        }
+    }
+
+} // namespace SoupSearch
@@ -0,0 +1,988 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "LifeKernel.h"
+#include "LoadBalance.h"
+#include "Parallel.h"
+#include "UniverseHash.h"
+
+namespace TiledEngine {
+
+    using LifeKernel::Rule;
+    using LifeKernel::Topology;
+
+    constexpr int tileSize = 64;
+
+    // Index of the tile containing coordinate c, rounding towards negative infinity.
+    inline int tileCoord(int c) {
+        return c >= 0 ? c / tileSize : -((-c + tileSize - 1) / tileSize);
+    }
+
+    // Position of coordinate c inside its tile, always in [0, tileSize).
+    inline int inTile(int c) {
+        return c - tileCoord(c) * tileSize;
+    }
+
+    // Position of a tile in tile units; tile (x, y) covers cells [64x, 64x + 64) x [64y, 64y + 64).
+    struct TileKey {
+        int x, y;
+
+        bool operator==(const TileKey& other) const {
+            return x == other.x && y == other.y;
+        }
+
+        bool operator!=(const TileKey& other) const {
+            return !(*this == other);
+        }
+
+        bool operator<(const TileKey& other) const {
+            return y < other.y || (y == other.y && x < other.x);
+        }
+    };
+
+    struct TileKeyHash {
+        size_t operator()(const TileKey& key) const {
+            uint64_t v = (uint64_t(uint32_t(key.x)) << 32) | uint32_t(key.y);
+            v *= 0x9E3779B97F4A7C15ull;
+            return size_t(v ^ (v >> 29));
+        }
+    };
+
+    // A 64x64 block of cells, one word per row with bit x holding column x.
+    struct Tile {
+        std::array<uint64_t, tileSize> rows{};
+
+        bool isEmpty() const {
+            for (uint64_t row : rows) {
+                if (row) return false;
+            }
+            return true;
+        }
+
+        size_t population() const {
+            size_t count = 0;
+            for (uint64_t row : rows) {
+                count += LifeKernel::popcount(row);
+            }
+            return count;
+        }
+
+        // Bounding box of the live cells of this tile placed at the given tile key.
+        UniverseHash::BoundingBox boundingBox(int originX, int originY) const {
+            UniverseHash::BoundingBox box;
+            uint64_t columns = 0;
+            for (int r = 0; r < tileSize; ++r) {
+                if (rows[r]) {
+                    box.minY = std::min(box.minY, originY + r);
+                    box.maxY = originY + r;
+                    columns |= rows[r];
+                }
+            }
+            if (columns) {
+                box.minX = originX + LifeKernel::countTrailingZeros(columns);
+                box.maxX = originX + 63 - LifeKernel::countTrailingZeros(LifeKernel::reverseBits(columns));
+            }
+            return box;
+        }
+
+        bool operator==(const Tile& other) const {
+            return rows == other.rows;
+        }
+
+        bool operator!=(const Tile& other) const {
+            return !(*this == other);
+        }
+    };
+
+    // Tiles are reference-counted so that they can be shared, e.g. with the memory-mapped
+    // file of a checkpoint. A tile is only modified in place while its reference is the only
+    // one; otherwise it is copied first.
+    using TileRef = std::shared_ptr<Tile>;
+    using TileMap = std::unordered_map<TileKey, TileRef, TileKeyHash>;
+
+    struct Cell {
+        int x;
+        int y;
+    };
+
+    // The births and deaths of one step, collected while the step computes each tile. `from`
+    // and `to` identify the tile maps before and after it, so that a reader can check the
+    // lists describe exactly the two states it holds. Cells are in no particular order.
+    struct Changes {
+        const TileMap* from = nullptr;
+        const TileMap* to = nullptr;
+        uint64_t generation = 0;
+        std::vector<Cell> births;
+        std::vector<Cell> deaths;
+    };
+
+    // Hash-consed tiles and memoized tile steps, shared by every universe that uses the store.
+    //
+    // intern() returns one shared tile per distinct content, so the empty-looking fields of
+    // blocks, blinkers and other repeated debris in a settled universe cost one tile each.
+    // The store keeps a reference to every tile it hands out, which makes them immutable:
+    // a universe that writes to one copies it first, as it does with any shared tile.
+    //
+    // A step's result depends only on the tile, its eight neighbours and the rule, so the
+    // memo maps those nine tile references to the interned next tile. Since equal contents
+    // are one tile, a repeated neighbourhood is computed once per generation however often it
+    // occurs, and not at all while it keeps recurring, which gives repetitive boards some of
+    // HashLife's gains without its quadtree. Memo entries hold their nine tiles, so a key's
+    // addresses cannot be reused while it is stored.
+    //
+    // Both tables are split into shards with their own lock, for the threads of a step and for
+    // forks stepping concurrently. A full memo shard is cleared; tiles nobody else holds are
+    // dropped once a shard doubles in size.
+    class TileStore {
+    public:
+        static constexpr size_t defaultMemoCapacity = size_t(1) << 18;
+
+        struct Stats {
+            uint64_t memoHits = 0;
+            uint64_t memoMisses = 0;
+            size_t uniqueTiles = 0;
+        };
+
+        explicit TileStore(size_t memoCapacity = defaultMemoCapacity)
+            : memoLimit(std::max<size_t>(memoCapacity / shardCount, 1)) {
+        }
+
+        // The shared tile holding `tile`'s cells, or null for an empty tile.
+        TileRef intern(const Tile& tile) {
+            if (tile.isEmpty()) {
+                return nullptr;
+            }
+            const uint64_t hash = hashOf(tile);
+            Shard& shard = shards[hash % shardCount];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto range = shard.tiles.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (*it->second == tile) {
+                    return it->second;
+                }
+            }
+            if (shard.tiles.size() >= shard.sweepAt) {
+                sweep(shard);
+            }
+            TileRef added = std::make_shared<Tile>(tile);
+            shard.tiles.emplace(hash, added);
+            return added;
+        }
+
+        // The remembered next tile for a neighbourhood, stored in `result`. Returns false when
+        // it is not known; an empty next tile is known and stored as null.
+        bool recall(const std::array<const Tile*, 9>& around, const Rule& rule, TileRef& result) {
+            const Neighborhood key{ around, ruleKey(rule) };
+            Shard& shard = shards[NeighborhoodHash()(key) % shardCount];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            const auto it = shard.memo.find(key);
+            if (it == shard.memo.end()) {
+                ++shard.misses;
+                return false;
+            }
+            ++shard.hits;
+            result = it->second.result;
+            return true;
+        }
+
+        // Remembers `result` as the next tile of the neighbourhood `inputs`, which are the
+        // references behind its nine pointers.
+        void remember(const std::array<TileRef, 9>& inputs, const Rule& rule, TileRef result) {
+            Neighborhood key{ {}, ruleKey(rule) };
+            for (int i = 0; i < 9; ++i) {
+                key.tiles[i] = inputs[i].get();
+            }
+            Shard& shard = shards[NeighborhoodHash()(key) % shardCount];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (shard.memo.size() >= memoLimit) {
+                shard.memo.clear();
+            }
+            shard.memo.emplace(key, MemoEntry{ inputs, std::move(result) });
+        }
+
+        Stats stats() {
+            Stats total;
+            for (Shard& shard : shards) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                total.memoHits += shard.hits;
+                total.memoMisses += shard.misses;
+                total.uniqueTiles += shard.tiles.size();
+            }
+            return total;
+        }
+
+    private:
+        static constexpr size_t shardCount = 64;
+
+        struct Neighborhood {
+            std::array<const Tile*, 9> tiles;
+            uint32_t rule;
+
+            bool operator==(const Neighborhood& other) const {
+                return tiles == other.tiles && rule == other.rule;
+            }
+        };
+
+        struct NeighborhoodHash {
+            size_t operator()(const Neighborhood& key) const {
+                uint64_t v = key.rule;
+                for (const Tile* tile : key.tiles) {
+                    v = (v ^ uint64_t(reinterpret_cast<uintptr_t>(tile))) * 0x9E3779B97F4A7C15ull;
+                    v ^= v >> 32;
+                }
+                return size_t(v);
+            }
+        };
+
+        struct MemoEntry {
+            std::array<TileRef, 9> inputs;
+            TileRef result;
+        };
+
+        struct Shard {
+            std::mutex mutex;
+            std::unordered_multimap<uint64_t, TileRef> tiles;
+            std::unordered_map<Neighborhood, MemoEntry, NeighborhoodHash> memo;
+            size_t sweepAt = 1024;
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+        };
+
+        static uint64_t hashOf(const Tile& tile) {
+            uint64_t v = 0xCBF29CE484222325ull;
+            for (uint64_t row : tile.rows) {
+                v = (v ^ row) * 0x100000001B3ull;
+                v ^= v >> 29;
+            }
+            return v;
+        }
+
+        static uint32_t ruleKey(const Rule& rule) {
+            return (uint32_t(rule.birth) << 16) | rule.survive;
+        }
+
+        // Drops the tiles only the store still holds. Tiles kept alive by memo entries stay.
+        static void sweep(Shard& shard) {
+            for (auto it = shard.tiles.begin(); it != shard.tiles.end();) {
+                it = it->second.use_count() == 1 ? shard.tiles.erase(it) : std::next(it);
+            }
+            shard.sweepAt = std::max<size_t>(1024, shard.tiles.size() * 2);
+        }
+
+        const size_t memoLimit;
+        std::array<Shard, shardCount> shards;
+    };
+
+    // An unbounded universe made of 64x64 bit tiles stored in a hash map, with only
+    // non-empty tiles kept. Each step visits the live tiles plus the neighbours their
+    // edges can spill into, and computes every next tile from a 66x66 halo gathered from
+    // its eight neighbours with the word kernel.
+    //
+    // The universe can also be bounded to tilesWide x tilesHigh tiles with a topology.
+    // Wrapping is resolved once per neighbour tile when the halo is gathered (possibly
+    // mirroring that tile's rows or columns), never per cell.
+    //
+    // Copying a universe is O(1): the copy shares the tile map and the tiles. The first edit
+    // to either side gives it its own map of references, still pointing at the shared tiles,
+    // and a tile is only cloned when it is written. A step builds a new map anyway, so forks
+    // that only step never copy anything, and forks can step concurrently on separate
+    // threads while they share the regions neither has changed.
+    class Universe {
+    public:
+        explicit Universe(Rule rule = Rule::conway()) {
+            setRule(rule);
+        }
+
+        // Declared so that moves copy too: a copy is as cheap as a move, and a moved-from
+        // universe keeps its tile map instead of being left without one.
+        Universe(const Universe&) = default;
+        Universe& operator=(const Universe&) = default;
+
+        const Rule& getRule() const {
+            return rule;
+        }
+
+        void setRule(const Rule& newRule) {
+            if ((newRule.birth & 1) && !bounded) {
+                throw std::invalid_argument("B0 rules need a bounded universe");
+            }
+            rule = newRule;
+        }
+
+        // Restricts the universe to [0, 64 * tilesWide) x [0, 64 * tilesHigh) with the given
+        // edge behaviour. Cells already outside the new bounds are dropped.
+        void setBounds(int tilesWide, int tilesHigh, Topology newTopology) {
+            if (tilesWide <= 0 || tilesHigh <= 0) {
+                throw std::invalid_argument("TiledEngine bounds must be positive");
+            }
+            bounded = true;
+            boundsWide = tilesWide;
+            boundsHigh = tilesHigh;
+            topology = newTopology;
+            TileMap& own = ownTiles();
+            for (auto it = own.begin(); it != own.end();) {
+                it = inBounds(it->first) ? std::next(it) : own.erase(it);
+            }
+            if (tracking) {
+                recomputeState();
+            }
+        }
+
+        void clearBounds() {
+            if (rule.birth & 1) {
+                throw std::invalid_argument("B0 rules need a bounded universe");
+            }
+            bounded = false;
+        }
+
+        bool isBounded() const {
+            return bounded;
+        }
+
+        Topology getTopology() const {
+            return topology;
+        }
+
+        int getBoundsWide() const {
+            return boundsWide;
+        }
+
+        int getBoundsHigh() const {
+            return boundsHigh;
+        }
+
+        bool get(int x, int y) const {
+            const Tile* tile = findTile({ tileCoord(x), tileCoord(y) });
+            return tile && ((tile->rows[inTile(y)] >> inTile(x)) & 1);
+        }
+
+        void set(int x, int y, bool alive) {
+            const TileKey key{ tileCoord(x), tileCoord(y) };
+            if (!inBounds(key)) {
+                return;
+            }
+            const uint64_t bit = uint64_t(1) << inTile(x);
+            if (get(x, y) == alive) {
+                return;
+            }
+            if (tracking) {
+                alive ? state.addCell(x, y) : state.removeCell(x, y);
+                boxStale = boxStale || !alive;
+            }
+            TileMap& own = ownTiles();
+            if (alive) {
+                writable(own[key]).rows[inTile(y)] |= bit;
+                return;
+            }
+            auto it = own.find(key);
+            Tile& tile = writable(it->second);
+            tile.rows[inTile(y)] &= ~bit;
+            if (tile.isEmpty()) {
+                own.erase(it);
+            }
+        }
+
+        void clear() {
+            tiles = std::make_shared<TileMap>();
+            changes.reset();
+            if (tracking) {
+                recomputeState();
+            }
+        }
+
+        // Turns on maintenance of the universe hash, population and bounding box.
+        // Steps then fold each tile's births and deaths into the hash as the tile is computed.
+        void setTracking(bool enabled) {
+            tracking = enabled;
+            if (tracking) {
+                recomputeState();
+            }
+        }
+
+        bool isTracking() const {
+            return tracking;
+        }
+
+        // Makes every step list its births and deaths, for renderers that patch what they drew
+        // instead of redrawing everything.
+        void setRecordingChanges(bool enabled) {
+            recordingChanges = enabled;
+            if (!enabled) {
+                changes.reset();
+            }
+        }
+
+        bool isRecordingChanges() const {
+            return recordingChanges;
+        }
+
+        // The births and deaths that turned `earlier` into this universe, if it is the state
+        // right before the last step and nothing but that step changed this universe since.
+        // Returns null otherwise, e.g. after an edit or when changes are not recorded.
+        const Changes* changesSince(const Universe& earlier) const {
+            if (changes && changes->from == earlier.tiles.get() && changes->to == tiles.get() &&
+                changes->generation == generation && earlier.generation + 1 == generation) {
+                return changes.get();
+            }
+            return nullptr;
+        }
+
+        // Makes steps intern their tiles in `tileStore` and reuse the results it remembers.
+        // Forks share the store. Pass null to step without one again.
+        void setTileStore(std::shared_ptr<TileStore> tileStore) {
+            store = std::move(tileStore);
+        }
+
+        const std::shared_ptr<TileStore>& getTileStore() const {
+            return store;
+        }
+
+        // Spreads the tiles of each step over the scheduler's workers by their measured cost,
+        // instead of in equal bands. Forks share the scheduler. Pass null to go back to bands.
+        void setScheduler(std::shared_ptr<LoadBalance::Scheduler> tileScheduler) {
+            scheduler = std::move(tileScheduler);
+        }
+
+        const std::shared_ptr<LoadBalance::Scheduler>& getScheduler() const {
+            return scheduler;
+        }
+
+        // Makes steps run on the calling thread only, for callers that already keep every
+        // core busy with one universe per thread. Forks inherit the setting; a scheduler set
+        // on the universe still takes precedence.
+        void setSerial(bool enabled) {
+            serial = enabled;
+        }
+
+        bool isSerial() const {
+            return serial;
+        }
+
+        // Hash summary of the current generation; only meaningful while tracking. A box left
+        // too large by removed cells is rebuilt from the tiles here, so reads after edits
+        // must not overlap with other reads of the same universe.
+        const UniverseHash::State& getState() const {
+            if (boxStale) {
+                state.box = UniverseHash::BoundingBox();
+                for (const auto& entry : *tiles) {
+                    state.box.merge(entry.second->boundingBox(entry.first.x * tileSize, entry.first.y * tileSize));
+                }
+                boxStale = false;
+            }
+            return state;
+        }
+
+        void recomputeState() {
+            boxStale = false;
+            state = UniverseHash::State();
+            state.generation = generation;
+            for (const auto& entry : *tiles) {
+                const int originX = entry.first.x * tileSize;
+                const int originY = entry.first.y * tileSize;
+                state.hash += UniverseHash::blockDelta(originX, originY, nullptr, entry.second->rows.data(), tileSize);
+                state.population += entry.second->population();
+                state.box.merge(entry.second->boundingBox(originX, originY));
+            }
+        }
+
+        size_t population() const {
+            size_t count = 0;
+            for (const auto& entry : *tiles) {
+                count += entry.second->population();
+            }
+            return count;
+        }
+
+        uint64_t getGeneration() const {
+            return generation;
+        }
+
+        // Sets the generation counter, for universes restored from a file.
+        void setGeneration(uint64_t value) {
+            generation = value;
+            state.generation = value;
+        }
+
+        // A copy that shares everything with this universe until either of them changes.
+        Universe fork() const {
+            return *this;
+        }
+
+        // True while this universe and `other` still share one tile map, i.e. neither has
+        // been edited or stepped since one was forked from the other. O(1).
+        bool sharesTilesWith(const Universe& other) const {
+            return tiles == other.tiles;
+        }
+
+        const TileMap& getTiles() const {
+            return *tiles;
+        }
+
+        const Tile* findTile(const TileKey& key) const {
+            auto it = tiles->find(key);
+            return it == tiles->end() ? nullptr : it->second.get();
+        }
+
+        // Replaces a whole tile at once; empty tiles are removed instead of stored.
+        void putTile(const TileKey& key, const Tile& tile) {
+            putTile(key, std::make_shared<Tile>(tile));
+        }
+
+        // Replaces a whole tile with a shared one, which is copied before any later write.
+        void putTile(const TileKey& key, TileRef shared) {
+            if (!inBounds(key)) {
+                return;
+            }
+            const Tile& tile = *shared;
+            if (tracking) {
+                const Tile* before = findTile(key);
+                const int originX = key.x * tileSize;
+                const int originY = key.y * tileSize;
+                state.hash += UniverseHash::blockDelta(originX, originY, before ? before->rows.data() : nullptr, tile.rows.data(), tileSize);
+                state.population += tile.population();
+                state.population -= before ? before->population() : 0;
+                state.box.merge(tile.boundingBox(originX, originY));
+                boxStale = boxStale || before;
+            }
+            if (tile.isEmpty()) {
+                if (findTile(key)) {
+                    ownTiles().erase(key);
+                }
+            }
+            else {
+                ownTiles()[key] = std::move(shared);
+            }
+        }
+
+        // Stores a shared, non-empty tile without reading it, so that tiles mapped from a file
+        // are not paged in until a step or a lookup needs them. The tracked state is left
+        // alone; call recomputeState() once all tiles are in if tracking is on.
+        void adoptTile(const TileKey& key, TileRef shared) {
+            if (inBounds(key)) {
+                ownTiles()[key] = std::move(shared);
+            }
+        }
+
+        // ORs a whole tile into the universe, for readers that assemble patterns tile by tile.
+        void mergeTile(const TileKey& key, const Tile& tile) {
+            const Tile* before = findTile(key);
+            if (!before) {
+                putTile(key, tile);
+                return;
+            }
+            Tile merged = *before;
+            for (int r = 0; r < tileSize; ++r) {
+                merged.rows[r] |= tile.rows[r];
+            }
+            putTile(key, merged);
+        }
+
+        // Calls fn(x, y) for every live cell, tile by tile.
+        template <typename Fn>
+        void forEachAlive(Fn&& fn) const {
+            for (const auto& entry : *tiles) {
+                const int originX = entry.first.x * tileSize;
+                const int originY = entry.first.y * tileSize;
+                for (int r = 0; r < tileSize; ++r) {
+                    uint64_t bits = entry.second->rows[r];
+                    while (bits) {
+                        fn(originX + LifeKernel::countTrailingZeros(bits), originY + r);
+                        bits &= bits - 1;
+                    }
+                }
+            }
+        }
+
+        // Advances the universe by one generation.
+        void step() {
+            std::vector<TileKey> candidates = collectCandidates();
+            // With a store the results are interned tiles (null when empty), otherwise values.
+            std::vector<Tile> results(store ? 0 : candidates.size());
+            std::vector<TileRef> shared(store ? candidates.size() : 0);
+            static const Tile emptyTile{};
+            auto result = [&](size_t i) -> const Tile& {
+                return store ? (shared[i] ? *shared[i] : emptyTile) : results[i];
+            };
+            std::vector<uint64_t> hashDeltas(tracking ? candidates.size() : 0);
+            std::shared_ptr<Changes> stepChanges = recordingChanges ? std::make_shared<Changes>() : nullptr;
+            std::mutex changesMutex;
+            auto computeTile = [&](size_t i, Changes& local) {
+                if (store) {
+                    shared[i] = storedNextTile(candidates[i]);
+                }
+                else {
+                    results[i] = nextTile(candidates[i]);
+                }
+                if (tracking || stepChanges) {
+                    const Tile* before = findTile(candidates[i]);
+                    if (tracking) {
+                        hashDeltas[i] = UniverseHash::blockDelta(candidates[i].x * tileSize, candidates[i].y * tileSize,
+                                                                 before ? before->rows.data() : nullptr, result(i).rows.data(), tileSize);
+                    }
+                    if (stepChanges) {
+                        collectChanges(candidates[i], before, result(i), local);
+                    }
+                }
+            };
+            auto mergeChanges = [&](const Changes& local) {
+                if (stepChanges && (!local.births.empty() || !local.deaths.empty())) {
+                    std::lock_guard<std::mutex> lock(changesMutex);
+                    stepChanges->births.insert(stepChanges->births.end(), local.births.begin(), local.births.end());
+                    stepChanges->deaths.insert(stepChanges->deaths.end(), local.deaths.begin(), local.deaths.end());
+                }
+            };
+            if (scheduler) {
+                std::vector<Changes> perWorker(scheduler->getThreadCount());
+                scheduler->forEach(candidates, [&](size_t i, unsigned worker) { computeTile(i, perWorker[worker]); });
+                for (const Changes& local : perWorker) {
+                    mergeChanges(local);
+                }
+            }
+            else if (serial) {
+                Changes local;
+                for (size_t i = 0; i < candidates.size(); ++i) {
+                    computeTile(i, local);
+                }
+                mergeChanges(local);
+            }
+            else {
+                Parallel::forRange(0, candidates.size(), [&](size_t first, size_t last) {
+                    Changes local;
+                    for (size_t i = first; i < last; ++i) {
+                        computeTile(i, local);
+                    }
+                    mergeChanges(local);
+                }, 16);
+            }
+
+            TileMap nextTiles;
+            nextTiles.reserve(candidates.size());
+            if (tracking) {
+                state.population = 0;
+                state.box = UniverseHash::BoundingBox();
+                boxStale = false;
+            }
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                if (tracking) {
+                    state.hash += hashDeltas[i];
+                }
+                const Tile& next = result(i);
+                if (!next.isEmpty()) {
+                    if (tracking) {
+                        state.population += next.population();
+                        state.box.merge(next.boundingBox(candidates[i].x * tileSize, candidates[i].y * tileSize));
+                    }
+                    if (store) {
+                        nextTiles.emplace(candidates[i], std::move(shared[i]));
+                        continue;
+                    }
+                    // Tiles that did not change keep their reference, so still regions stay shared.
+                    auto it = tiles->find(candidates[i]);
+                    if (it != tiles->end() && *it->second == next) {
+                        nextTiles.emplace(candidates[i], it->second);
+                    }
+                    else {
+                        nextTiles.emplace(candidates[i], std::make_shared<Tile>(next));
+                    }
+                }
+            }
+            if (stepChanges) {
+                stepChanges->from = tiles.get();
+            }
+            tiles = std::make_shared<TileMap>(std::move(nextTiles));
+            ++generation;
+            state.generation = generation;
+            if (stepChanges) {
+                stepChanges->to = tiles.get();
+                stepChanges->generation = generation;
+            }
+            changes = std::move(stepChanges);
+        }
+
+    private:
+        // The tile map, copied first if a fork still shares it. Only the references are
+        // copied; the tiles stay shared until they are written.
+        TileMap& ownTiles() {
+            // Every edit goes through here, and after one the last step's changes no longer apply.
+            changes.reset();
+            if (tiles.use_count() > 1) {
+                tiles = std::make_shared<TileMap>(*tiles);
+            }
+            return *tiles;
+        }
+
+        // The tile behind a reference, copied first if anyone else can see it.
+        static Tile& writable(TileRef& ref) {
+            if (!ref) {
+                ref = std::make_shared<Tile>();
+            }
+            else if (ref.use_count() > 1) {
+                ref = std::make_shared<Tile>(*ref);
+            }
+            return *ref;
+        }
+
+        // A neighbour tile as seen from across an edge, possibly mirrored by the topology.
+        struct NeighborRef {
+            const Tile* tile = nullptr;
+            bool flipX = false;
+            bool flipY = false;
+
+            uint64_t row(int r) const {
+                if (!tile) {
+                    return 0;
+                }
+                const uint64_t word = tile->rows[flipY ? tileSize - 1 - r : r];
+                return flipX ? LifeKernel::reverseBits(word) : word;
+            }
+        };
+
+        bool inBounds(const TileKey& key) const {
+            return !bounded || (key.x >= 0 && key.y >= 0 && key.x < boundsWide && key.y < boundsHigh);
+        }
+
+        static int wrap(int value, int size) {
+            const int r = value % size;
+            return r < 0 ? r + size : r;
+        }
+
+        // Maps the tile at `key` moved by (dx, dy) onto the stored tile it stands for.
+        // Returns false when that position lies beyond a wall.
+        bool resolve(const TileKey& key, int dx, int dy, TileKey& target, bool& flipX, bool& flipY) const {
+            int x = key.x + dx;
+            int y = key.y + dy;
+            flipX = false;
+            flipY = false;
+            if (bounded) {
+                const bool outX = x < 0 || x >= boundsWide;
+                const bool outY = y < 0 || y >= boundsHigh;
+                switch (topology) {
+                case Topology::Wall:
+                    if (outX || outY) return false;
+                    break;
+                case Topology::Torus:
+                    break;
+                case Topology::KleinBottle:
+                    if (outY) {
+                        x = boundsWide - 1 - x;
+                        flipX = true;
+                    }
+                    break;
+                case Topology::CrossSurface:
+                    if (outX) {
+                        y = boundsHigh - 1 - y;
+                        flipY = true;
+                    }
+                    if (outY) {
+                        x = boundsWide - 1 - x;
+                        flipX = true;
+                    }
+                    break;
+                }
+                x = wrap(x, boundsWide);
+                y = wrap(y, boundsHigh);
+            }
+            target = { x, y };
+            return true;
+        }
+
+        NeighborRef neighbor(const TileKey& key, int dx, int dy) const {
+            NeighborRef ref;
+            TileKey target;
+            if (resolve(key, dx, dy, target, ref.flipX, ref.flipY)) {
+                ref.tile = findTile(target);
+            }
+            return ref;
+        }
+
+        static void collectChanges(const TileKey& key, const Tile* before, const Tile& after, Changes& out) {
+            const int originX = key.x * tileSize;
+            const int originY = key.y * tileSize;
+            for (int r = 0; r < tileSize; ++r) {
+                const uint64_t old = before ? before->rows[r] : 0;
+                for (uint64_t born = after.rows[r] & ~old; born; born &= born - 1) {
+                    out.births.push_back({ originX + LifeKernel::countTrailingZeros(born), originY + r });
+                }
+                for (uint64_t died = old & ~after.rows[r]; died; died &= died - 1) {
+                    out.deaths.push_back({ originX + LifeKernel::countTrailingZeros(died), originY + r });
+                }
+            }
+        }
+
+        // Live tiles plus every neighbour that a live cell on one of their edges touches.
+        // Under a B0 rule empty tiles come alive too, so every tile within the bounds is one.
+        std::vector<TileKey> collectCandidates() const {
+            std::vector<TileKey> candidates;
+            if (rule.birth & 1) {
+                candidates.reserve(size_t(boundsWide) * size_t(boundsHigh));
+                for (int y = 0; y < boundsHigh; ++y) {
+                    for (int x = 0; x < boundsWide; ++x) {
+                        candidates.push_back({ x, y });
+                    }
+                }
+                return candidates;
+            }
+            candidates.reserve(tiles->size() * 2);
+            auto activate = [&](const TileKey& key, int dx, int dy) {
+                TileKey target;
+                bool flipX, flipY;
+                if (resolve(key, dx, dy, target, flipX, flipY)) {
+                    candidates.push_back(target);
+                }
+            };
+            for (const auto& entry : *tiles) {
+                const TileKey& key = entry.first;
+                const auto& rows = entry.second->rows;
+                uint64_t columns = 0;
+                for (uint64_t row : rows) {
+                    columns |= row;
+                }
+                const bool west = columns & 1;
+                const bool east = columns >> 63;
+                const bool north = rows[0] != 0;
+                const bool south = rows[tileSize - 1] != 0;
+
+                candidates.push_back(key);
+                if (north) activate(key, 0, -1);
+                if (south) activate(key, 0, 1);
+                if (west) activate(key, -1, 0);
+                if (east) activate(key, 1, 0);
+                if (rows[0] & 1) activate(key, -1, -1);
+                if (rows[0] >> 63) activate(key, 1, -1);
+                if (rows[tileSize - 1] & 1) activate(key, -1, 1);
+                if (rows[tileSize - 1] >> 63) activate(key, 1, 1);
+            }
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+            return candidates;
+        }
+
+        // The interned next tile at `key`, from the store's memo when it has seen the
+        // neighbourhood before. Neighbourhoods with mirrored neighbours are not remembered.
+        TileRef storedNextTile(const TileKey& key) const {
+            std::array<const Tile*, 9> around{};
+            bool mirrored = false;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const NeighborRef ref = neighbor(key, dx, dy);
+                    around[(dy + 1) * 3 + dx + 1] = ref.tile;
+                    mirrored = mirrored || ((ref.flipX || ref.flipY) && ref.tile);
+                }
+            }
+            TileRef next;
+            if (!mirrored && store->recall(around, rule, next)) {
+                return next;
+            }
+            next = store->intern(nextTile(key));
+            if (!mirrored) {
+                std::array<TileRef, 9> inputs;
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        TileKey target;
+                        bool flipX, flipY;
+                        if (resolve(key, dx, dy, target, flipX, flipY)) {
+                            const auto it = tiles->find(target);
+                            if (it != tiles->end()) {
+                                inputs[(dy + 1) * 3 + dx + 1] = it->second;
+                            }
+                        }
+                    }
+                }
+                store->remember(inputs, rule, next);
+            }
+            return next;
+        }
+
+        // Gathers the 66-row halo around a tile and runs the kernel over its 64 rows.
+        Tile nextTile(const TileKey& key) const {
+            NeighborRef around[3][3];
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    around[dy + 1][dx + 1] = neighbor(key, dx, dy);
+                }
+            }
+
+            // Index r + 1 holds tile row r; indices 0 and 65 are the halo rows.
+            uint64_t center[tileSize + 2];
+            uint64_t west[tileSize + 2];
+            uint64_t east[tileSize + 2];
+            for (int r = 0; r < tileSize; ++r) {
+                const uint64_t c = around[1][1].row(r);
+                west[r + 1] = LifeKernel::westOf(c, around[1][0].row(r));
+                east[r + 1] = LifeKernel::eastOf(c, around[1][2].row(r));
+                center[r + 1] = c;
+            }
+            const uint64_t top = around[0][1].row(tileSize - 1);
+            west[0] = LifeKernel::westOf(top, around[0][0].row(tileSize - 1));
+            east[0] = LifeKernel::eastOf(top, around[0][2].row(tileSize - 1));
+            center[0] = top;
+            const uint64_t bottom = around[2][1].row(0);
+            west[tileSize + 1] = LifeKernel::westOf(bottom, around[2][0].row(0));
+            east[tileSize + 1] = LifeKernel::eastOf(bottom, around[2][2].row(0));
+            center[tileSize + 1] = bottom;
+
+            Tile result;
+            for (int r = 0; r < tileSize; ++r) {
+                result.rows[r] = LifeKernel::nextWord(west[r], center[r], east[r],
+                                                      west[r + 1], center[r + 1], east[r + 1],
+                                                      west[r + 2], center[r + 2], east[r + 2], rule);
+            }
+            return result;
+        }
+
+        std::shared_ptr<TileMap> tiles = std::make_shared<TileMap>();
+        Rule rule;
+        uint64_t generation = 0;
+
+        bool tracking = false;
+        // Mutable so that getState() can shrink the box after cells were removed.
+        mutable UniverseHash::State state;
+        mutable bool boxStale = false;
+        bool serial = false;
+
+        std::shared_ptr<TileStore> store;
+        std::shared_ptr<LoadBalance::Scheduler> scheduler;
+
+        // Shared so that copying a universe stays O(1).
+        bool recordingChanges = false;
+        std::shared_ptr<const Changes> changes;
+
+        bool bounded = false;
+        int boundsWide = 0;
+        int boundsHigh = 0;
+        Topology topology = Topology::Torus;
+    };
+
+    // How many tile references a universe holds and how many distinct tiles are behind them.
+    struct Sharing {
+        size_t references = 0;
+        size_t distinct = 0;
+
+        double ratio() const {
+            return distinct ? double(references) / double(distinct) : 1.0;
+        }
+
+        size_t savedBytes() const {
+            return (references - distinct) * sizeof(Tile);
+        }
+    };
+
+    inline Sharing measureSharing(const Universe& universe) {
+        Sharing sharing;
+        std::unordered_map<const Tile*, bool> seen;
+        for (const auto& entry : universe.getTiles()) {
+            ++sharing.references;
+            seen.emplace(entry.second.get(), true);
+        }
+        sharing.distinct = seen.size();
+        return sharing;
+    }
+
+} // namespace TiledEngine
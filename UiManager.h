@@ -1,5 +1,9 @@
 #pragma once
 #include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
 
 class UIManager {
 private:
@@ -18,13 +22,69 @@ private:
     sf::RectangleShape dropdownButton;
     sf::Text dropdownButtonText;
     bool dropdownExpanded;
-    std::vector<std::string> dropdownOptions;
+    // The options come from the pattern library's index and may number in the thousands, so
+    // only the rows that fit below the button get a text; scrolling swaps their strings.
+    size_t optionCount = 0;
+    size_t firstOption = 0;
+    std::function<std::string(size_t)> optionName;
     std::vector<sf::Text> dropdownOptionsText;
 
     std::string selectedPattern;
 
     sf::RectangleShape clearButton;
     sf::Text clearButtonText;
+
+    sf::RectangleShape autoPauseCheckbox;
+    sf::RectangleShape autoPauseCheckmark;
+    sf::Text autoPauseText;
+    bool autoPauseChecked;
+
+    sf::Text statusText;
+
+    sf::RectangleShape timelineTrack;
+    sf::RectangleShape timelineThumb;
+    sf::Text timelineText;
+    uint64_t timelineFirst = 0;
+    uint64_t timelineLast = 0;
+
+    // The panel is drawn into a texture only when something on it changed, and the window
+    // then draws that texture as a single sprite. Without render texture support the
+    // shapes are drawn straight to the window as before.
+    sf::RenderTexture panelTexture;
+    sf::Sprite panelSprite;
+    bool panelCached = false;
+    bool dirty = true;
+
+    void drawPanel(sf::RenderTarget& target) {
+        target.draw(controlPanel);
+        target.draw(controlPanelText);
+        target.draw(checkbox);
+        if (checkboxChecked) target.draw(checkmark);
+        target.draw(checkboxText);
+        target.draw(startButton);
+        target.draw(startButtonText);
+
+        target.draw(dropdownButton);
+        target.draw(dropdownButtonText);
+
+        if (dropdownExpanded) {
+            for (size_t i = 0; i < visibleOptionCount(); ++i) {
+                target.draw(dropdownOptionsText[i]);
+            }
+        }
+
+        target.draw(clearButton);
+        target.draw(clearButtonText);
+
+        target.draw(autoPauseCheckbox);
+        if (autoPauseChecked) target.draw(autoPauseCheckmark);
+        target.draw(autoPauseText);
+        target.draw(statusText);
+
+        target.draw(timelineTrack);
+        target.draw(timelineThumb);
+        target.draw(timelineText);
+    }
 public:
     UIManager(sf::Font& font, sf::RenderWindow& window) {
         // Control Panel
@@ -85,14 +145,15 @@ public:
 
         dropdownExpanded = false;
 
-        // Initialize dropdown options
-        dropdownOptions = { "Pulsar", "LLWS", "Gosper Glider Gun", "Ben Special" };
-        for (const auto& option : dropdownOptions) {
+        // Dropdown option rows, as many as fit between the button and the bottom of the window
+        const float optionsTop = dropdownButton.getPosition().y + 30;
+        const size_t visibleOptions = std::max<size_t>(1, size_t((window.getSize().y - optionsTop) / 15));
+        for (size_t i = 0; i < visibleOptions; ++i) {
             sf::Text optionText;
             optionText.setFont(font);
-            optionText.setString(option);
             optionText.setCharacterSize(16);
             optionText.setFillColor(sf::Color::Color(238, 238, 238));
+            optionText.setPosition(dropdownButton.getPosition().x, optionsTop + i * 15.0f);
             dropdownOptionsText.push_back(optionText);
         }
 
@@ -111,6 +172,57 @@ public:
             clearButton.getPosition().y + (clearButton.getSize().y - clearTextBounds.height) / 2.0f - clearTextBounds.top
         );
 
+        // Auto-pause checkbox, stops the game once the universe is detected as stable
+        autoPauseCheckbox.setSize(sf::Vector2f(20, 20));
+        autoPauseCheckbox.setPosition(10, controlPanel.getPosition().y + 92);
+        autoPauseCheckbox.setFillColor(sf::Color(238, 238, 238));
+        autoPauseChecked = false;
+
+        autoPauseCheckmark.setSize(sf::Vector2f(10, 10));
+        autoPauseCheckmark.setPosition(autoPauseCheckbox.getPosition().x + 5, autoPauseCheckbox.getPosition().y + 5);
+        autoPauseCheckmark.setFillColor(sf::Color(176, 197, 164));
+
+        autoPauseText.setFont(font);
+        autoPauseText.setString("Pause When Stable");
+        autoPauseText.setCharacterSize(16);
+        autoPauseText.setFillColor(sf::Color(238, 238, 238));
+        autoPauseText.setPosition(autoPauseCheckbox.getPosition().x + autoPauseCheckbox.getSize().x + 10, controlPanel.getPosition().y + 92);
+
+        // Status line, reports what the stabilization detector found
+        statusText.setFont(font);
+        statusText.setCharacterSize(16);
+        statusText.setFillColor(sf::Color(176, 197, 164));
+        statusText.setPosition(200, controlPanel.getPosition().y + 92);
+
+        // Timeline slider over the recorded history, with the shown generation next to it
+        timelineTrack.setSize(sf::Vector2f(window.getSize().x - 360.0f, 6));
+        timelineTrack.setPosition(200, controlPanel.getPosition().y + 127);
+        timelineTrack.setFillColor(sf::Color(34, 40, 49));
+
+        timelineThumb.setSize(sf::Vector2f(8, 16));
+        timelineThumb.setFillColor(sf::Color(176, 197, 164));
+        timelineThumb.setPosition(timelineTrack.getPosition().x - 4, timelineTrack.getPosition().y - 5);
+
+        timelineText.setFont(font);
+        timelineText.setCharacterSize(16);
+        timelineText.setFillColor(sf::Color(238, 238, 238));
+        timelineText.setPosition(timelineTrack.getPosition().x + timelineTrack.getSize().x + 15, controlPanel.getPosition().y + 119);
+
+        // The texture covers the panel from its top to the bottom of the window, where the
+        // dropdown options also end, in the same coordinates as the window's default view.
+        const sf::Vector2f panelSize = controlPanel.getSize();
+        if (panelTexture.create(unsigned(panelSize.x), unsigned(panelSize.y))) {
+            panelTexture.setView(sf::View(sf::FloatRect(controlPanel.getPosition(), panelSize)));
+            panelSprite.setTexture(panelTexture.getTexture(), true);
+            panelSprite.setPosition(controlPanel.getPosition());
+            panelCached = true;
+        }
+    }
+
+    // Forces the next draw to render the panel again, e.g. after the window was resized
+    // and its contents may have been lost.
+    void invalidate() {
+        dirty = true;
     }
 
     void updateCheckboxText() {
@@ -118,38 +230,30 @@ public:
     }
 
     void draw(sf::RenderWindow& window) {
-        window.draw(controlPanel);
-        window.draw(controlPanelText);
-        window.draw(checkbox);
-        if (checkboxChecked) window.draw(checkmark);
-        window.draw(checkboxText);
-        window.draw(startButton);
-        window.draw(startButtonText);
-
-        window.draw(dropdownButton);
-        window.draw(dropdownButtonText);
-
-        if (dropdownExpanded) {
-            for (size_t i = 0; i < dropdownOptionsText.size(); ++i) {
-                float offsetY = 15 + (i + 1) * 15;
-                dropdownOptionsText[i].setPosition(dropdownButton.getPosition().x, dropdownButton.getPosition().y + offsetY);
-                window.draw(dropdownOptionsText[i]);
-            }
+        if (!panelCached) {
+            drawPanel(window);
+            return;
         }
-
-        window.draw(clearButton);
-        window.draw(clearButtonText);
+        if (dirty) {
+            panelTexture.clear(sf::Color::Transparent);
+            drawPanel(panelTexture);
+            panelTexture.display();
+            dirty = false;
+        }
+        window.draw(panelSprite);
     }
 
     void toggleDropdown(sf::RenderWindow& window, sf::Vector2i mousePos) {
         if (dropdownButton.getGlobalBounds().contains(static_cast<sf::Vector2f>(mousePos))) {
             dropdownExpanded = !dropdownExpanded;
+            dirty = true;
         }
         else if (dropdownExpanded) {
-            for (size_t i = 0; i < dropdownOptionsText.size(); ++i) {
+            for (size_t i = 0; i < visibleOptionCount(); ++i) {
                 if (dropdownOptionsText[i].getGlobalBounds().contains(static_cast<sf::Vector2f>(mousePos))) {
                     dropdownExpanded = false;
-                    selectedPattern = dropdownOptions.at(i);
+                    dirty = true;
+                    selectedPattern = optionName(firstOption + i);
                     break;
                 }
             }
@@ -161,10 +265,46 @@ public:
             sf::Vector2i mousePos = sf::Mouse::getPosition(window);
             toggleDropdown(window, mousePos);
         }
+        else if (event.type == sf::Event::MouseWheelScrolled && dropdownExpanded) {
+            scrollDropdown(event.mouseWheelScroll.delta > 0 ? -1 : 1);
+        }
+    }
+
+    // Fills the dropdown with `count` options named by `nameOf`, which is only called for
+    // the rows on screen.
+    void setPatternOptions(size_t count, std::function<std::string(size_t)> nameOf) {
+        optionCount = count;
+        optionName = std::move(nameOf);
+        firstOption = 0;
+        refreshDropdownOptions();
+    }
+
+    // Moves the visible window of options by `rows`, clamped to the list.
+    void scrollDropdown(int rows) {
+        const size_t lastFirst = optionCount - visibleOptionCount();
+        const long long target = (long long)firstOption + rows;
+        firstOption = size_t(std::clamp<long long>(target, 0, (long long)lastFirst));
+        refreshDropdownOptions();
+    }
+
+    bool isDropdownExpanded() const {
+        return dropdownExpanded;
+    }
+
+    size_t visibleOptionCount() const {
+        return std::min(optionCount, dropdownOptionsText.size());
+    }
+
+    void refreshDropdownOptions() {
+        for (size_t i = 0; i < visibleOptionCount(); ++i) {
+            dropdownOptionsText[i].setString(optionName(firstOption + i));
+        }
+        dirty = true;
     }
 
     void toggleCheckbox(sf::RenderWindow& window) {
         checkboxChecked = !checkboxChecked;
+        dirty = true;
         checkboxChecked ? checkmark.setFillColor(sf::Color::Color(176, 197, 164)) : checkmark.setFillColor(sf::Color::Color(238, 238, 238));
         updateCheckboxText();
     }
@@ -185,17 +325,7 @@ public:
 	bool isStartButtonClicked(sf::Vector2i mousePos) {
 		if (startButton.getGlobalBounds().contains(static_cast<sf::Vector2f>(mousePos)))
 		{
-			if (isGameRunning())
-			{
-				startButton.setFillColor(sf::Color::Color(176, 197, 164));
-				setStartButtonText("Start Game");
-			}
-			else
-			{
-				startButton.setFillColor(sf::Color::Color(211, 118, 118));
-				setStartButtonText("Stop Game");
-			}
-			isRunning = !isRunning;
+			setRunning(!isRunning);
 
 			return true;
 		}
@@ -203,6 +333,23 @@ public:
 		return false;
 	}
 
+	// Starts or stops the game and keeps the start button in sync, so the
+	// simulation can also be paused from code (e.g. once it has stabilized).
+	void setRunning(bool running) {
+		if (running)
+		{
+			startButton.setFillColor(sf::Color::Color(211, 118, 118));
+			setStartButtonText("Stop Game");
+		}
+		else
+		{
+			startButton.setFillColor(sf::Color::Color(176, 197, 164));
+			setStartButtonText("Start Game");
+		}
+		isRunning = running;
+		dirty = true;
+	}
+
 	bool isGameRunning()
 	{
 		return isRunning;
@@ -210,6 +357,7 @@ public:
 
 	void setStartButtonText(const std::string& text) {
 		startButtonText.setString(text);
+		dirty = true;
 	}
 
 	bool isCheckboxClicked(sf::Vector2i mousePos) const {
@@ -228,6 +376,59 @@ public:
         return clearButton.getGlobalBounds().contains(static_cast<sf::Vector2f>(mousePos));
     }
 
+    bool isAutoPauseClicked(sf::Vector2i mousePos) const {
+        return autoPauseCheckbox.getGlobalBounds().contains(static_cast<sf::Vector2f>(mousePos));
+    }
+
+    void toggleAutoPause() {
+        autoPauseChecked = !autoPauseChecked;
+        dirty = true;
+    }
+
+    bool isAutoPauseChecked() const {
+        return autoPauseChecked;
+    }
+
+    void setStatus(const std::string& status) {
+        if (statusText.getString() != status) {
+            statusText.setString(status);
+            dirty = true;
+        }
+    }
+
+    // Spans the slider over the recorded generations [first, last] and moves its thumb to `current`.
+    void setTimeline(uint64_t first, uint64_t last, uint64_t current) {
+        timelineFirst = first;
+        timelineLast = std::max(first, last);
+        const uint64_t span = timelineLast - timelineFirst;
+        const float fraction = span ? float(double(std::clamp(current, timelineFirst, timelineLast) - timelineFirst) / double(span)) : 1.0f;
+        const sf::Vector2f thumb(timelineTrack.getPosition().x + fraction * timelineTrack.getSize().x - timelineThumb.getSize().x / 2,
+                                 timelineThumb.getPosition().y);
+        const std::string label = "Gen " + std::to_string(current);
+        // Called every frame, so only an actual change costs a redraw
+        if (thumb != timelineThumb.getPosition() || timelineText.getString() != label) {
+            timelineThumb.setPosition(thumb);
+            timelineText.setString(label);
+            dirty = true;
+        }
+    }
+
+    // The slider is easier to grab than its track is tall, so clicks a few pixels off count.
+    bool isTimelineClicked(sf::Vector2i mousePos) const {
+        sf::FloatRect bounds = timelineTrack.getGlobalBounds();
+        bounds.left -= 6;
+        bounds.width += 12;
+        bounds.top -= 8;
+        bounds.height += 16;
+        return bounds.contains(static_cast<sf::Vector2f>(mousePos));
+    }
+
+    // The recorded generation under a horizontal mouse position on the slider.
+    uint64_t timelineGenerationAt(int mouseX) const {
+        const float fraction = std::clamp((mouseX - timelineTrack.getPosition().x) / timelineTrack.getSize().x, 0.0f, 1.0f);
+        return timelineFirst + uint64_t(double(fraction) * double(timelineLast - timelineFirst) + 0.5);
+    }
+
     bool isRestrainedClick(sf::Vector2i mousePos) const {
         return controlPanel.getGlobalBounds().contains(static_cast<sf::Vector2f>(mousePos));
     }
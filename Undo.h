@@ -0,0 +1,191 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+#include "History.h"
+#include "Lz.h"
+#include "TiledEngine.h"
+
+// Undo and redo for edits to a tiled universe.
+//
+// An edit is bracketed by begin() and commit(). begin() forks the universe, which is O(1),
+// and commit() stores only the difference: the XOR of every changed row of every changed
+// tile, as History computes it, with the words compressed by Lz. Undoing or redoing an
+// edit applies the same XOR, so either direction only touches the tiles the edit changed.
+//
+// Anything that changes the universe between edits, such as running it or scrubbing its
+// history, is recorded the same way as a jump when the next edit or undo comes, so undo
+// always walks back through exactly the states the user saw. Records beyond the memory
+// budget are dropped, oldest first.
+namespace Undo {
+
+    struct Record {
+        uint64_t generationBefore = 0;
+        uint64_t generationAfter = 0;
+        std::vector<History::TileDelta> tiles;
+        std::vector<uint8_t> packed;
+        size_t wordCount = 0;
+        bool compressed = false;
+
+        size_t bytes() const {
+            return sizeof(Record) + tiles.capacity() * sizeof(History::TileDelta) + packed.capacity();
+        }
+    };
+
+    // Packs the change from `before` to `after`. The words are kept raw when Lz cannot
+    // shrink them, e.g. for a pasted random soup.
+    inline Record makeRecord(const TiledEngine::Universe& before, const TiledEngine::Universe& after) {
+        History::Delta delta = History::diff(before, after);
+        Record record;
+        record.generationBefore = before.getGeneration();
+        record.generationAfter = after.getGeneration();
+        record.tiles = std::move(delta.tiles);
+        record.wordCount = delta.words.size();
+        const uint8_t* raw = reinterpret_cast<const uint8_t*>(delta.words.data());
+        const size_t rawBytes = delta.words.size() * sizeof(uint64_t);
+        Lz::compress(raw, rawBytes, record.packed);
+        record.compressed = record.packed.size() < rawBytes;
+        if (!record.compressed) {
+            record.packed.assign(raw, raw + rawBytes);
+        }
+        record.packed.shrink_to_fit();
+        return record;
+    }
+
+    // Applies a record to a universe in the state on one side of it, which moves it to the
+    // other side, and sets the generation to `generation`.
+    inline void toggle(const Record& record, TiledEngine::Universe& universe, uint64_t generation) {
+        History::Delta delta;
+        delta.tiles = record.tiles;
+        delta.words.resize(record.wordCount);
+        uint8_t* words = reinterpret_cast<uint8_t*>(delta.words.data());
+        if (record.compressed) {
+            if (!Lz::decompress(record.packed.data(), record.packed.size(), words, record.wordCount * sizeof(uint64_t))) {
+                throw std::runtime_error("Undo record is corrupt");
+            }
+        }
+        else if (!record.packed.empty()) {
+            std::memcpy(words, record.packed.data(), record.packed.size());
+        }
+        History::apply(delta, universe);
+        universe.setGeneration(generation);
+    }
+
+    class Stack {
+    public:
+        static constexpr size_t defaultBudget = size_t(64) << 20;
+
+        explicit Stack(size_t memoryBudget = defaultBudget) : budget(memoryBudget) {
+        }
+
+        // Call before changing the universe.
+        void begin(const TiledEngine::Universe& universe) {
+            recordJump(universe);
+            before = universe.fork();
+        }
+
+        // Call after the change. Returns false, recording nothing, if nothing changed.
+        bool commit(const TiledEngine::Universe& universe) {
+            const bool changed = push(before, universe);
+            current = universe.fork();
+            before = TiledEngine::Universe();
+            return changed;
+        }
+
+        bool canUndo(const TiledEngine::Universe& universe) const {
+            return !undoRecords.empty() || (tracking && !universe.sharesTilesWith(current));
+        }
+
+        bool canRedo() const {
+            return !redoRecords.empty();
+        }
+
+        // Moves the universe back to the state before the last edit or jump.
+        bool undo(TiledEngine::Universe& universe) {
+            recordJump(universe);
+            if (undoRecords.empty()) {
+                return false;
+            }
+            Record record = std::move(undoRecords.back());
+            undoRecords.pop_back();
+            toggle(record, universe, record.generationBefore);
+            redoRecords.push_back(std::move(record));
+            current = universe.fork();
+            return true;
+        }
+
+        // Reapplies the last undone record. Any edit or jump in between clears the redo list.
+        bool redo(TiledEngine::Universe& universe) {
+            recordJump(universe);
+            if (redoRecords.empty()) {
+                return false;
+            }
+            Record record = std::move(redoRecords.back());
+            redoRecords.pop_back();
+            toggle(record, universe, record.generationAfter);
+            undoRecords.push_back(std::move(record));
+            current = universe.fork();
+            trim();
+            return true;
+        }
+
+        void clear() {
+            undoRecords.clear();
+            redoRecords.clear();
+            used = 0;
+            tracking = false;
+        }
+
+        size_t memoryUsed() const {
+            return used;
+        }
+
+    private:
+        // Records whatever happened to the universe since the last record, if anything.
+        void recordJump(const TiledEngine::Universe& universe) {
+            if (tracking && !universe.sharesTilesWith(current)) {
+                push(current, universe);
+            }
+            current = universe.fork();
+            tracking = true;
+        }
+
+        bool push(const TiledEngine::Universe& from, const TiledEngine::Universe& to) {
+            if (from.sharesTilesWith(to) && from.getGeneration() == to.getGeneration()) {
+                return false;
+            }
+            Record record = makeRecord(from, to);
+            if (record.tiles.empty() && record.generationBefore == record.generationAfter) {
+                return false;
+            }
+            for (const Record& dropped : redoRecords) {
+                used -= dropped.bytes();
+            }
+            redoRecords.clear();
+            used += record.bytes();
+            undoRecords.push_back(std::move(record));
+            trim();
+            return true;
+        }
+
+        // Both lists count towards the budget; the newest undo record is always kept.
+        void trim() {
+            while (used > budget && undoRecords.size() > 1) {
+                used -= undoRecords.front().bytes();
+                undoRecords.pop_front();
+            }
+        }
+
+        size_t budget;
+        size_t used = 0;
+        bool tracking = false;
+        std::deque<Record> undoRecords;
+        std::vector<Record> redoRecords;
+        TiledEngine::Universe before;
+        TiledEngine::Universe current;
+    };
+
+} // namespace Undo
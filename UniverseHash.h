@@ -0,0 +1,298 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "LifeKernel.h"
+
+// Incremental, translation-aware hashing of a universe and detection of the point where
+// a run settles into a still life, an oscillator or a moving spaceship.
+//
+// Each cell (x, y) has the key A^x * B^y (mod 2^64) for two fixed odd bases and the hash of a
+// universe is the sum of the keys of its live cells. Like a Zobrist hash it is updated in
+// O(1) per birth (add the key) or death (subtract it), but because keys are exponential in
+// the coordinates, translating a universe by (dx, dy) multiplies its hash by A^dx * B^dy.
+// Multiplying by A^-minX * B^-minY therefore gives a hash that is independent of position,
+// which is what lets spaceships be recognised without comparing cells.
+namespace UniverseHash {
+
+    constexpr uint64_t baseX = 0x9E3779B97F4A7C15ull;
+    constexpr uint64_t baseY = 0xD6E8FEB86659FD93ull;
+
+    // Multiplicative inverse of an odd number modulo 2^64, by Newton iteration.
+    inline uint64_t inverse(uint64_t odd) {
+        uint64_t x = odd;
+        for (int i = 0; i < 6; ++i) {
+            x *= 2 - odd * x;
+        }
+        return x;
+    }
+
+    // base^exponent modulo 2^64, negative exponents using the inverse of base.
+    inline uint64_t power(uint64_t base, long long exponent) {
+        if (exponent < 0) {
+            base = inverse(base);
+            exponent = -exponent;
+        }
+        uint64_t result = 1;
+        while (exponent) {
+            if (exponent & 1) {
+                result *= base;
+            }
+            base *= base;
+            exponent >>= 1;
+        }
+        return result;
+    }
+
+    inline uint64_t cellKey(int x, int y) {
+        return power(baseX, x) * power(baseY, y);
+    }
+
+    // Powers A^0..A^63 and B^0..B^63, enough to hash any cell of a 64-wide word or tile
+    // from one power computed for the word's origin.
+    inline const std::array<uint64_t, 64>& wordPowersX() {
+        static const std::array<uint64_t, 64> table = []() {
+            std::array<uint64_t, 64> powers{};
+            for (int i = 0; i < 64; ++i) powers[i] = power(baseX, i);
+            return powers;
+        }();
+        return table;
+    }
+
+    inline const std::array<uint64_t, 64>& wordPowersY() {
+        static const std::array<uint64_t, 64> table = []() {
+            std::array<uint64_t, 64> powers{};
+            for (int i = 0; i < 64; ++i) powers[i] = power(baseY, i);
+            return powers;
+        }();
+        return table;
+    }
+
+    // Sum of A^bit over the set bits of a word.
+    inline uint64_t wordKey(uint64_t bits) {
+        const auto& powers = wordPowersX();
+        uint64_t sum = 0;
+        while (bits) {
+            sum += powers[LifeKernel::countTrailingZeros(bits)];
+            bits &= bits - 1;
+        }
+        return sum;
+    }
+
+    // Smallest rectangle containing every live cell. An empty box has min > max.
+    struct BoundingBox {
+        int minX = INT_MAX, minY = INT_MAX;
+        int maxX = INT_MIN, maxY = INT_MIN;
+
+        bool isEmpty() const {
+            return minX > maxX;
+        }
+
+        void include(int x, int y) {
+            minX = std::min(minX, x);
+            minY = std::min(minY, y);
+            maxX = std::max(maxX, x);
+            maxY = std::max(maxY, y);
+        }
+
+        void merge(const BoundingBox& other) {
+            if (!other.isEmpty()) {
+                include(other.minX, other.minY);
+                include(other.maxX, other.maxY);
+            }
+        }
+
+        bool sameSize(const BoundingBox& other) const {
+            return maxX - minX == other.maxX - other.minX && maxY - minY == other.maxY - other.minY;
+        }
+    };
+
+    // Summary of a universe at one generation, maintained by the engines while they step.
+    struct State {
+        uint64_t generation = 0;
+        uint64_t hash = 0;
+        size_t population = 0;
+        BoundingBox box;
+
+        void addCell(int x, int y) {
+            hash += cellKey(x, y);
+            ++population;
+            box.include(x, y);
+        }
+
+        // Leaves the box as it is: shrinking it takes the remaining cells, which only the
+        // engine holding them can look at.
+        void removeCell(int x, int y) {
+            hash -= cellKey(x, y);
+            --population;
+        }
+
+        // The hash the same pattern would have if its bounding box started at (0, 0).
+        uint64_t normalizedHash() const {
+            if (box.isEmpty()) {
+                return 0;
+            }
+            return hash * power(baseX, -(long long)box.minX) * power(baseY, -(long long)box.minY);
+        }
+    };
+
+    // Builds a State from scratch for a list of cells, after edits outside of a step.
+    // Cells listed more than once are counted once.
+    template <typename Cells>
+    State stateOf(const Cells& cells, uint64_t generation) {
+        std::vector<std::pair<int, int>> unique;
+        unique.reserve(cells.size());
+        for (const auto& cell : cells) {
+            unique.emplace_back(cell.x, cell.y);
+        }
+        std::sort(unique.begin(), unique.end());
+        unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+        State state;
+        state.generation = generation;
+        for (const auto& cell : unique) {
+            state.addCell(cell.first, cell.second);
+        }
+        return state;
+    }
+
+    // Hash change of a block of 64-bit rows whose bit 0 of row 0 sits at (originX, originY),
+    // going from `before` (null for an empty block) to `after`. Only changed bits are visited.
+    inline uint64_t blockDelta(int originX, int originY, const uint64_t* before, const uint64_t* after, int rows) {
+        const auto& powersY = wordPowersY();
+        uint64_t delta = 0;
+        for (int r = 0; r < rows; ++r) {
+            const uint64_t old = before ? before[r] : 0;
+            const uint64_t changed = old ^ after[r];
+            if (changed) {
+                delta += (wordKey(changed & after[r]) - wordKey(changed & old)) * powersY[r];
+            }
+        }
+        return delta ? delta * power(baseX, originX) * power(baseY, originY) : 0;
+    }
+
+    // The verdict of the detector: once `stable` is set, the universe at `generation` reappears
+    // every `period` generations, moved by (dx, dy) each time. Still lifes have period 1,
+    // oscillators have no displacement and spaceships have some.
+    struct Stabilization {
+        bool stable = false;
+        int period = 0;
+        uint64_t generation = 0;
+        int dx = 0;
+        int dy = 0;
+
+        bool isSpaceship() const {
+            return stable && (dx != 0 || dy != 0);
+        }
+
+        std::string describe() const {
+            if (!stable) {
+                return "";
+            }
+            std::string kind = period == 1 ? "Still" : "Period " + std::to_string(period);
+            if (isSpaceship()) {
+                kind = "Ship (" + std::to_string(dx) + "," + std::to_string(dy) + ")c/" + std::to_string(period);
+            }
+            return kind + " since gen " + std::to_string(generation);
+        }
+    };
+
+    // Remembers the last historySize generations in a ring buffer and compares each new
+    // State against them by population and hash only. Detection is probabilistic: two
+    // different universes would have to collide on a 64-bit hash to fool it.
+    class Detector {
+    public:
+        explicit Detector(size_t historySize = 256) : history(historySize) {}
+
+        void reset() {
+            count = 0;
+            next = 0;
+            verdict = Stabilization();
+        }
+
+        const Stabilization& result() const {
+            return verdict;
+        }
+
+        // Records the universe after a step and returns the current verdict.
+        const Stabilization& record(const State& state) {
+            if (verdict.stable) {
+                return verdict;
+            }
+            const uint64_t normalized = state.normalizedHash();
+            for (size_t age = 1; age <= count; ++age) {
+                const Entry& past = history[(next + history.size() - age) % history.size()];
+                if (past.population != state.population || state.generation <= past.generation) {
+                    continue;
+                }
+                const int period = int(state.generation - past.generation);
+                if (past.hash == state.hash) {
+                    verdict = { true, period, past.generation, 0, 0 };
+                    break;
+                }
+                if (past.normalized == normalized && past.box.sameSize(state.box)) {
+                    verdict = { true, period, past.generation, state.box.minX - past.box.minX, state.box.minY - past.box.minY };
+                    break;
+                }
+            }
+            history[next] = { state.generation, state.hash, normalized, state.population, state.box };
+            next = (next + 1) % history.size();
+            count = std::min(count + 1, history.size());
+            if (verdict.stable) {
+                findOnset();
+            }
+            return verdict;
+        }
+
+    private:
+        struct Entry {
+            uint64_t generation = 0;
+            uint64_t hash = 0;
+            uint64_t normalized = 0;
+            size_t population = 0;
+            BoundingBox box;
+        };
+
+        const Entry* find(uint64_t generation) const {
+            for (size_t age = 1; age <= count; ++age) {
+                const Entry& entry = history[(next + history.size() - age) % history.size()];
+                if (entry.generation == generation) {
+                    return &entry;
+                }
+            }
+            return nullptr;
+        }
+
+        // A repeat is noticed one period after the cycle starts. Walks the history back to the
+        // earliest generation still matching its successor one period later, so the verdict
+        // names the first generation of the cycle as far as the history reaches.
+        void findOnset() {
+            while (verdict.generation > 0) {
+                const Entry* earlier = find(verdict.generation - 1);
+                const Entry* later = find(verdict.generation - 1 + uint64_t(verdict.period));
+                if (!earlier || !later || earlier->population != later->population) {
+                    break;
+                }
+                const bool matches = verdict.isSpaceship()
+                    ? earlier->normalized == later->normalized && later->box.minX - earlier->box.minX == verdict.dx
+                                                                 && later->box.minY - earlier->box.minY == verdict.dy
+                    : earlier->hash == later->hash;
+                if (!matches) {
+                    break;
+                }
+                --verdict.generation;
+            }
+        }
+
+        std::vector<Entry> history;
+        size_t count = 0;
+        size_t next = 0;
+        Stabilization verdict;
+    };
+
+} // namespace UniverseHash